@@ -10,26 +10,62 @@ CMD_SRCS += \
 
 C_SRCS += \
 ../TM1638.c \
-../main.c 
+../bench.c \
+../ds18b20.c \
+../history.c \
+../main.c \
+../onewire.c \
+../sched.c \
+../trace.c 
 
 C_DEPS += \
 ./TM1638.d \
-./main.d 
+./bench.d \
+./ds18b20.d \
+./history.d \
+./main.d \
+./onewire.d \
+./sched.d \
+./trace.d 
 
 OBJS += \
 ./TM1638.obj \
-./main.obj 
+./bench.obj \
+./ds18b20.obj \
+./history.obj \
+./main.obj \
+./onewire.obj \
+./sched.obj \
+./trace.obj 
 
 OBJS__QUOTED += \
 "TM1638.obj" \
-"main.obj" 
+"bench.obj" \
+"ds18b20.obj" \
+"history.obj" \
+"main.obj" \
+"onewire.obj" \
+"sched.obj" \
+"trace.obj" 
 
 C_DEPS__QUOTED += \
 "TM1638.d" \
-"main.d" 
+"bench.d" \
+"ds18b20.d" \
+"history.d" \
+"main.d" \
+"onewire.d" \
+"sched.d" \
+"trace.d" 
 
 C_SRCS__QUOTED += \
 "../TM1638.c" \
-"../main.c" 
+"../bench.c" \
+"../ds18b20.c" \
+"../history.c" \
+"../main.c" \
+"../onewire.c" \
+"../sched.c" \
+"../trace.c" 
 
 
@@ -48,8 +48,14 @@
 //  
 //******************************************************************************
 
-#include  <msp430g2553.h>
+#include  "hal.h"
 #include  "TM1638.h"
+#include  "delay.h"
+
+#define SPI_BR ((CLOCK_SMCLK_FREQ + SPI_FREQ - 1) / SPI_FREQ)	//SMCLK divider, rounded to stay under SPI_FREQ
+#if SPI_FREQ > 1000000L || SPI_BR > 0xFFFF
+#error "SPI_FREQ: TM1638 clock out of range for CLOCK_MHZ"
+#endif
 
 // MSP430 Ports Define
 #define LED_RED BIT0 						//RED Led
@@ -117,7 +123,7 @@ const unsigned int ASCII[] = {					//Code table of symbols
 0x6E, // (89)	Y
 0x5B, // (90)	Z
 0x39, // (91)	[
-0x64, // (92)	\
+0x64, // (92)	<backslash>
 0x0F, // (93)	]
 0x00, // (94)	^
 0x08, // (95)	_
@@ -190,81 +196,249 @@ const unsigned int DEGREE = 0x63;
 //const unsigned int C = 0x39;
 const unsigned int U = 0x3E;
 
+static unsigned char DisplayRAM[16];		//Shadow of TM1638 display RAM
+static unsigned int DirtyMask;				//Bit n set - DisplayRAM[n] not yet sent
+
+//SPI transmit queue, filled by SpiSubmit(), drained by the USCI TX ISR.
+//Every transfer is one STROBE low cycle: command byte, then len data bytes.
+//The RX interrupt of the last byte, once it is shifted out, raises STROBE;
+//the next transfer starts from the TX ISR after that.
+#define SPI_GAP	0xFF						//SpiPos: STROBE high, next transfer waits
+typedef struct {
+	const unsigned char *data;				//0 - the inline value
+	unsigned char cmd;
+	unsigned char len;
+	unsigned char value;
+} SpiXfer;
+
+static SpiXfer SpiQueue[SPI_QUEUE_LEN];
+static volatile unsigned char SpiHead;		//Written by SpiSubmit() only
+static volatile unsigned char SpiTail;		//Written by the TX ISR only
+static unsigned char SpiPos;				//Data bytes of SpiQueue[SpiTail] sent, or SPI_GAP
+static unsigned char SpiSeq;				//Tickets handed out
+static volatile unsigned char SpiDoneSeq;	//Tickets completed
+
+static unsigned int KeyQueue[KEY_QUEUE_LEN];	//Key events, KeyScan() -> GetKeyEvent()
+static unsigned char KeyHead;		//Written by KeyScan() only
+static unsigned char KeyTail;		//Written by GetKeyEvent() only
+static unsigned char KeyRaw;				//Last raw scan
+static unsigned char KeyCount;				//Equal raw scans in a row
+static unsigned char KeyState;				//Debounced keys
+static unsigned char KeyHold;				//Scans since last press/repeat
+
 //Function definitions
 
 void init_Ports()
 {
-	  P1DIR |= LED_RED + LED_GRE + STROBE_TM1638;
-	  P1SEL = BIT1 + BIT2 + BIT4;			// Set secondary functions for PORT1
-	  P1SEL2 = BIT1 + BIT2 + BIT4;			// P1.1 - TXD, P1.2 - RXD
-	  P1OUT |= STROBE_TM1638;				// Set STROBE = "1" (Chip Select)
+	  HAL_LED_DIR |= LED_RED + LED_GRE;
+	  HAL_STROBE_DIR |= STROBE_TM1638;
+	  HAL_SPI_SEL = HAL_SPI_PINS;			// Set secondary functions for PORT1
+	  HAL_SPI_SEL2 = HAL_SPI_PINS;			// DIO, CLK of the SPI USCI
+	  HAL_STROBE_OUT |= STROBE_TM1638;		// Set STROBE = "1" (Chip Select)
 }
 
 void init_WDT()
 {
-	  WDTCTL = WDTPW + WDTHOLD;				//Stop watchdog
+	  HAL_WDT_CTL = WDTPW + WDTHOLD;				//Stop watchdog
 }
 
 void init_SPI()
 {
-	  UCA0CTL0 |= UCCKPL + UCMST + UCSYNC;  // 3-pin, 8-bit SPI master
-	  UCA0CTL1 |= UCSSEL_2;                 // SMCLK
-	  UCA0BR0 |= 0x02;                      // /2
-	  UCA0BR1 = 0;                          //
-	  UCA0MCTL = 0;                         // No modulation
-	  UCA0CTL1 &= ~UCSWRST;                 // **Initialize USCI state machine**
+	  HAL_SPI_CTL0 |= UCCKPL + UCMST + UCSYNC;	// 3-pin, 8-bit SPI master
+	  HAL_SPI_CTL1 |= UCSSEL_2;				// SMCLK
+	  HAL_SPI_BR0 = SPI_BR & 0xFF;			// SMCLK / SPI_BR
+	  HAL_SPI_BR1 = SPI_BR >> 8;			//
+#ifdef HAL_SPI_MCTL
+	  HAL_SPI_MCTL = 0;						// No modulation
+#endif
+	  HAL_SPI_CTL1 &= ~UCSWRST;				// **Initialize USCI state machine**
+}
+
+
+static void SpiStart() {					//Begin SpiQueue[SpiTail], TX ISR does the rest
+	HAL_STROBE_OUT &= ~STROBE_TM1638;		//Set STROBE = "0"
+	SpiPos = 0;
+	HAL_SPI_TXBUF = SpiQueue[SpiTail].cmd;
+	HAL_SPI_TXIE_ON;
+}
+
+//RX ISR: last byte of the transfer shifted out, raise STROBE. 1 - queue drained
+int SpiEnd() {
+	HAL_SPI_RXIE_OFF;
+	HAL_STROBE_OUT |= STROBE_TM1638;		//Set STROBE = "1"
+	SpiTail = (SpiTail + 1) & (SPI_QUEUE_LEN - 1);
+	SpiDoneSeq++;
+	if (SpiTail != SpiHead) {
+		SpiPos = SPI_GAP;					//TX ISR starts it, STROBE stays high
+		HAL_SPI_TXIE_ON;					//over this return and its entry, >= 1us
+		return 0;
+	}
+	return 1;
 }
 
+static int SpiNext() {						//TXBUF free: next byte, or wait for the last
+	SpiXfer *x = &SpiQueue[SpiTail];		//1 - queue drained
+	if (SpiPos == SPI_GAP) {
+		SpiStart();
+		return 0;
+	}
+	if (SpiPos < x->len) {
+		HAL_SPI_TXBUF = x->data ? x->data[SpiPos] : x->value;
+		SpiPos++;
+		return 0;
+	}
+	HAL_SPI_TXIE_OFF;						//Last byte in the shift register,
+	(void)HAL_SPI_RXBUF;					//the one before it is in: drop its RXIFG
+	if (HAL_SPI_BUSY) {
+		HAL_SPI_RXIE_ON;					//RXIFG again when the last is out
+		return 0;
+	}
+	return SpiEnd();						//Out already, this ISR came late
+}
+
+static void SpiWait() {						//Let the queue move on while main waits
+	if (!(HAL_INT_STATE() & GIE)) {			//Interrupts off (start-up): run the ISRs here
+		if (HAL_SPI_RX_PENDING)
+			SpiEnd();
+		else if (HAL_SPI_TX_PENDING)
+			SpiNext();
+	}
+}
+
+static unsigned char SpiPut(unsigned char cmd, const unsigned char *data,
+		unsigned char len, unsigned char value) {
+	unsigned char head = SpiHead;
+	unsigned char next = (head + 1) & (SPI_QUEUE_LEN - 1);
+	unsigned short state;
+	SpiXfer *x = &SpiQueue[head];
+	while (next == SpiTail) {				//Full, ISR frees a slot
+		SpiWait();
+	}
+	x->cmd = cmd;
+	x->len = len;
+	x->data = data;
+	x->value = value;
+	state = HAL_INT_STATE();
+	HAL_INT_OFF();
+	SpiHead = next;
+	if (SpiTail == head) {					//Queue was idle
+		SpiStart();
+	}
+	HAL_INT_RESTORE(state);
+	return ++SpiSeq;						//Ticket for SpiDone()
+}
+
+//Queue a transfer, main only. data must stay valid until SpiDone(ticket),
+//waits while the queue is full.
+unsigned char SpiSubmit(unsigned char cmd, const unsigned char *data, unsigned char len) {
+	return SpiPut(cmd, data, len, 0);
+}
+
+int SpiDone(unsigned char ticket) {			//1 - transfer with this ticket is finished
+	return (signed char)(SpiDoneSeq - ticket) >= 0;
+}
+
+int SpiBusy() {								//1 - transfers queued or running
+	return SpiHead != SpiTail;
+}
+
+void SpiFlush() {							//Wait for the queue to drain
+	while (SpiBusy()) {
+		SpiWait();
+	}
+}
 
 void SendCommand(unsigned char Command) {	//Transmit Command
-	P1OUT &= ~STROBE_TM1638;				//Set STROBE = "0"
-	_NOP();
-	_NOP();
-	P1OUT |= STROBE_TM1638;					//Set STROBE = "1"
-	_NOP();
-	_NOP();
-	P1OUT &= ~STROBE_TM1638;				//Set STROBE = "0"
-	_NOP();
-	UCA0TXBUF = Command;
-	while (!(IFG2 & UCA0TXIFG));
-	P1OUT |= STROBE_TM1638;					//Set STROBE = "1"
+	SpiSubmit(Command, 0, 0);
 }
 
 void SendData(unsigned int address, unsigned int data) {   		//Transmit Data
 	SendCommand(DATA_WRITE_FIX_ADDR);
-	P1OUT &= ~STROBE_TM1638;				//Set STROBE = "0"
-	UCA0TXBUF = (0xC0 | address);			//Set first address
-	while (!(IFG2 & UCA0TXIFG));
-	UCA0TXBUF = data;						//Send data
-	while (!(IFG2 & UCA0TXIFG));
-	P1OUT |= STROBE_TM1638;					//Set STROBE = "1"
+	SpiPut(0xC0 | address, 0, 1, data);		//Data byte kept in the queue entry
+}
+
+void SetData(unsigned int address, unsigned int data) {		//Write shadow RAM only
+	address &= 0x0F;
+	if (DisplayRAM[address] != (unsigned char)data) {
+		DisplayRAM[address] = data;
+		DirtyMask |= 1u << address;
+	}
+}
+
+void DisplayRefresh() {						//Send changed span of shadow RAM
+	unsigned int mask, first, last;
+	if (!DirtyMask) {
+		return;
+	}
+	mask = DirtyMask;
+	for (first = 0; !(mask & 1); first++) {
+		mask >>= 1;
+	}
+	for (last = first; mask >>= 1; last++);
+	DirtyMask = 0;
+	SendCommand(DATA_WRITE_INCR_ADDR);		//Then one strobe cycle for whole span,
+	SpiSubmit(ADDRSET | first, &DisplayRAM[first], last - first + 1);	//sent from DisplayRAM
 }
 
 void ShowDig(int position, int Data, int Dot)			//show single digit
 {
-	SendData(position << 1, Num [Data] | (Dot ? 0x80 : 0) );
+	SetData(position << 1, Num [Data] | (Dot ? 0x80 : 0) );
 }
 
 void ClearDig (unsigned int position, unsigned int Dot)
 {
-	SendData(position << 1, 0x00 | (Dot ? 0x80 : 0) );
+	SetData(position << 1, 0x00 | (Dot ? 0x80 : 0) );
 }
 
 void ShowError() {
 	unsigned int j;
 	for (j=0; j<8; j++) {
-		SendData(j, ERROR_DATA [j]);
+		SetData(j << 1, ERROR_DATA [j]);
 	}
 }
 
+#ifdef HAL_BCD_ADD_LONG
+#define BcdDouble(bcd) HAL_BCD_ADD_LONG((bcd), (bcd))	//DADD, bcd * 2 in decimal
+#else
+static unsigned long BcdDouble(unsigned long bcd)		//bcd * 2 in decimal
+{
+	unsigned long adj = ((bcd + 0x33333333) & 0x88888888) >> 3;	//1 per digit >= 5
+	return (bcd + (adj << 1) + adj) << 1;
+}
+#endif
+
+static unsigned long ToBCD(unsigned long number) {		//Double dabble, no division
+	unsigned long bcd = 0;
+	unsigned int word, mask;
+	if (number >> 16) {
+		word = number >> 16;
+		for (mask = 0x8000; mask; mask >>= 1) {
+			bcd = BcdDouble(bcd);
+			if (word & mask) {
+				bcd |= 1;
+			}
+		}
+	}
+	word = number;
+	for (mask = 0x8000; mask; mask >>= 1) {
+		bcd = BcdDouble(bcd);
+		if (word & mask) {
+			bcd |= 1;
+		}
+	}
+	return bcd;
+}
+
 void ShowDecNumber (unsigned long number, unsigned int dots, unsigned int startingPos) {
 	unsigned int i;
+	unsigned long bcd;
   if (number > 99999999) {
     ShowError();
   } else {
+    bcd = ToBCD(number);
     for (i = 0; i < 6 - startingPos; i++) {
-        ShowDig(7 - i, number % 10, (dots & (1 << i)) != 0);
-        number /= 10;
+        SetData((7 - i) << 1, Num[(unsigned int)bcd & 0x0F] | ((dots & (1 << i)) ? 0x80 : 0));
+        bcd >>= 4;
     }
   }
 }
@@ -278,18 +452,26 @@ void ShowSignedDecNumber ( signed long number, int dots)
 		    ShowError();
 		} else {
 			ShowDecNumber(-number, dots, 1);
-			SendData(0, MINUS);
+			SetData(2 << 1, MINUS);			//Sign just left of the digits
 		}
 	}
 }
 
 
+void ShowHexNumber (unsigned long number, int dots) {
+	unsigned int i;
+	for (i = 0; i < 8; i++) {
+		SetData((7 - i) << 1, Num[(unsigned int)number & 0x0F] | ((dots & (1 << i)) ? 0x80 : 0));
+		number >>= 4;
+	}
+}
+
 void ShowString (const char * string, unsigned int dots, unsigned int pos) {
 	unsigned int i;
 
   for (i = 0; i < 8 - pos; i++) {
   	if (string[i] != '\0') {
-  		SendData( (pos + i) << 1, ASCII[ string[i] - 32] | ((dots & (1 << (7 - i ))) ? 0x80 : 0));
+  		SetData( (pos + i) << 1, ASCII[ string[i] - 32] | ((dots & (1 << (7 - i ))) ? 0x80 : 0));
 	} else {
 	  break;
 	}
@@ -299,55 +481,115 @@ void ShowString (const char * string, unsigned int dots, unsigned int pos) {
 void ShowLed ( int Number, int Color)
 {
 	if (Number) {
-		SendData((Number << 1)-1, Color);
+		SetData((Number << 1)-1, Color);
 	}
 }
 
 void ShowLeds(int Color) {
 	unsigned int i;
 	for (i=1; i<9; i++) {
-	SendData((i << 1)-1, Color);
+	SetData((i << 1)-1, Color);
 	}
 }
 
 void DisplayClean() {						//Clean RAM of TM1638
-	int i;
-	SendCommand(DATA_WRITE_INCR_ADDR);		//Set address mode
-	for (i=0; i<17; i++) {
-		SendData(i, 0x00);
-		}
-	P1OUT |= STROBE_TM1638;					// Set STROBE = "1" (Chip Select)
+	unsigned int i;
+	for (i=0; i<16; i++) {
+		DisplayRAM[i] = 0x00;
+	}
+	DirtyMask = 0xFFFF;						//Resend all 16 cells in one burst
+	DisplayRefresh();
 }
 
 void SetupDisplay(char active, char intensity) {
 	SendCommand (0x80 | (active ? 8 : 0) | intensity);
-	P1OUT |= STROBE_TM1638;					// Set STROBE = "1"
 }
 
 void init_Display() {
-	__delay_cycles(100000);					//Time to initial TM1638
+	DELAY_MS(100);							//Time to initial TM1638
 	DisplayClean();							//Clean display
 	SendCommand(DISP_OFF);					//Display off
 	SendCommand(DATA_WRITE_FIX_ADDR);		//Set address mode
 	SendCommand(ADDRSET);					//Set first adress
 }
 
-int GetKey() {
+int GetKey() {								//Synchronous, needs an idle queue
 	unsigned int KeyData = 0;
 	unsigned int i;
-	P1OUT &= ~STROBE_TM1638;				// Set STROBE = "0"
-	UCA0TXBUF = DATA_READ_KEY_SCAN_MODE;
-	while (!(IFG2 & UCA0TXIFG));
-	__delay_cycles(20);						//wait to scan keys ready (see datasheet)
-	UCA0TXBUF = 0xff;						//Send dummy byte
-	while (!(IFG2 & UCA0TXIFG));			//wait for buffer ready
-											// 1'st reseiving byte = bad (unknown reason)
+	SpiFlush();
+	HAL_STROBE_OUT &= ~STROBE_TM1638;		// Set STROBE = "0"
+	HAL_SPI_TXBUF = DATA_READ_KEY_SCAN_MODE;
+	while (HAL_SPI_BUSY);					//Command out of the shift register
+	DELAY_US(20);							//wait to scan keys ready (see datasheet)
+	(void)HAL_SPI_RXBUF;					//Drop the echo of the command, it
+											//set RXIFG and was read as key byte 1
 	for (i=0; i<4; i++) {
-		UCA0TXBUF = 0xff;
-		while (!(IFG2 & UCA0RXIFG));
-		KeyData |= UCA0RXBUF << i;
+		HAL_SPI_TXBUF = 0xff;
+		while (!HAL_SPI_RX_READY);
+		KeyData |= HAL_SPI_RXBUF << i;
 	}
-	P1OUT |= STROBE_TM1638;					//Set STROBE = "1"
+	HAL_STROBE_OUT |= STROBE_TM1638;		//Set STROBE = "1"
 	return KeyData;
 }
 
+void KeyScanTick() {						//Timer0_A1 ISR on CCR2: next compare, main scans
+	unsigned int ccr = HAL_KEY_CCR + KEY_SCAN_TICKS;
+	if (ccr > HAL_TICK_TOP)
+		ccr -= HAL_TICK_TOP + 1;
+	HAL_KEY_CCR = ccr;
+}
+
+void init_KeyScan() {						//Start periodic scan on Timer0_A CCR2
+	KeyScanTick();
+	HAL_KEY_CCTL = CCIE;
+}
+
+static void PutKeyEvent(unsigned int event) {	//Single producer side of KeyQueue
+	unsigned char next = (KeyHead + 1) & (KEY_QUEUE_LEN - 1);
+	if (next != KeyTail) {					//Full - drop, main is not reading anyway
+		KeyQueue[KeyHead] = event;
+		KeyHead = next;
+	}
+}
+
+int KeyScan() {								//Main, once per KeyScanTick(), 1 - event queued
+	unsigned char keys, changed;			//GetKey() waits on the bus, ISRs
+	unsigned char head = KeyHead;			//keep running meanwhile
+	keys = GetKey();
+	if (keys != KeyRaw) {					//Still bouncing, start counting again
+		KeyRaw = keys;
+		KeyCount = 1;
+		return 0;
+	}
+	if (KeyCount < KEY_DEBOUNCE && ++KeyCount < KEY_DEBOUNCE)
+		return 0;
+	changed = keys ^ KeyState;
+	if (changed) {
+		if (changed & keys)
+			PutKeyEvent(KEY_PRESS | (changed & keys));
+		if (changed & KeyState)
+			PutKeyEvent(KEY_RELEASE | (changed & KeyState));
+		KeyState = keys;
+		KeyHold = 0;
+	} else if (keys && ++KeyHold >= KEY_REPEAT_DELAY) {
+		KeyHold = KEY_REPEAT_DELAY - KEY_REPEAT_RATE;
+		PutKeyEvent(KEY_REPEAT | keys);
+	}
+	return KeyHead != head;
+}
+
+unsigned int GetKeyEvent() {				//Next key event, 0 - queue empty
+	unsigned int event;
+	unsigned char tail = KeyTail;
+	if (tail == KeyHead)
+		return 0;
+	event = KeyQueue[tail];
+	KeyTail = (tail + 1) & (KEY_QUEUE_LEN - 1);
+	return event;
+}
+
+HAL_ISR(HAL_SPI_VECTOR, USCIAB0TX) {
+	if (SpiNext()) {
+		HAL_WAKE();							//Main may go back to LPM3
+	}
+}
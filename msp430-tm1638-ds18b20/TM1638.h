@@ -19,7 +19,21 @@
 #define TM1638_KEY8     0x80    // Key8
 //
 
-#define STROBE_TM1638 BIT5
+// Key events from GetKeyEvent(): type | mask of TM1638_KEYx
+#define KEY_PRESS       0x0100  // Keys went down
+#define KEY_RELEASE     0x0200  // Keys went up
+#define KEY_REPEAT      0x0400  // Keys still held, auto-repeat
+#define KEY_MASK        0x00FF
+
+#define KEY_SCAN_TICKS  328     // ACLK ticks between scans, ~10 ms
+#define KEY_DEBOUNCE    3       // Equal scans before a change counts
+#define KEY_REPEAT_DELAY 50     // Scans held before first repeat, ~500 ms
+#define KEY_REPEAT_RATE 15      // Scans between repeats, ~150 ms
+#define KEY_QUEUE_LEN   8       // Power of two
+#define SPI_QUEUE_LEN   4       // SPI transfers queued, power of two
+#define SPI_FREQ        500000L // SPI clock, TM1638 takes up to 1MHz
+
+#define STROBE_TM1638 HAL_STROBE_PIN		// hal.h, P1.5 or P1.4 with OW_UART
 #define DIO BIT2
 #define CLK BIT4
 
@@ -37,8 +51,15 @@
 void init_Ports();
 void init_WDT();
 void init_SPI();
+unsigned char SpiSubmit(unsigned char cmd, const unsigned char *data, unsigned char len);
+int SpiDone(unsigned char ticket);
+int SpiBusy();
+int SpiEnd();
+void SpiFlush();
 void SendCommand(unsigned char Command);
 void SendData(unsigned int address, unsigned int data);
+void SetData(unsigned int address, unsigned int data);
+void DisplayRefresh();
 void ShowDig(int position, int Data, int Dot);
 void ClearDig (unsigned int position, unsigned int Dot);
 void ShowError();
@@ -52,6 +73,10 @@ void DisplayClean();
 void SetupDisplay(char active, char intensity);
 void init_Display();
 int GetKey();
+void init_KeyScan();
+void KeyScanTick();
+int KeyScan();
+unsigned int GetKeyEvent();
 
 
 
@@ -0,0 +1,304 @@
+#include "hal.h"
+#include "stdint.h"
+#include "TM1638.h"
+#include "onewire.h"
+#include "ds18b20.h"
+#include "clock.h"
+#include "bench.h"
+
+#if BENCH
+
+// ##################### Benchmarks ###############################
+// bench_run() calls every hot path BENCH_RUNS times on the target and
+// keeps the fastest run, so a stray interrupt does not spoil a result.
+// Timer1_A counts SMCLK in continuous mode for the 1-Wire engine, its
+// counter doubles as the cycle counter. The benchmarks run in a burst.
+// Cases that only compute run with SMCLK = MCLK and are exact to the
+// cycle; cases that wait on the SPI or the 1-Wire bus need the normal
+// SMCLK for their bit timing and are counted in steps of CLOCK_SMCLK_DIV
+// MCLK cycles. Before each call the free stack from HAL_STACK_LOW up to
+// the caller's SP is painted and afterwards scanned for the deepest
+// overwritten word, interrupt frames included.
+// The table is read with the debugger (bench_results in the Expressions
+// view, or a memory save of it) and diffed between builds. Code size per
+// function is in the linker map of the same build.
+// The cases marked sweep take each of bench_inputs[] in turn: cycles is
+// then the fastest input's, cycles_max the slowest's, both best of
+// BENCH_RUNS. For the others cycles_max is cycles.
+// With BENCH_SIM bench_sim() runs the cases marked sim in mspdebug's
+// simulator, Timer1_A being its timer simio at 0x0180, prints them as CSV
+// lines "csv:name,sym,cycles,cycles_max,stack" to its console simio at BENCH_CONSOLE
+// and stops at bench_done(). bench.mk adds the size of sym from the ELF.
+
+#ifndef HAL_STACK_LOW
+#error "BENCH: hal.h has no stack bounds for this compiler"
+#endif
+
+#define BENCH_PAINT     0x5A5A
+#define BENCH_CONSOLE   (*(volatile unsigned char *) 0x01F0)    // bench.mk
+
+static const uint8_t bench_pad[9] = {
+    0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0x1C
+};
+
+static void b_empty()
+{
+}
+
+static void b_SendData()
+{
+    SendData(0, 0x3F);
+    SpiFlush();                             // until the last byte is out
+}
+
+static volatile unsigned long bench_number = 12345678;
+
+// Sweep of the two ShowDecNumber paths. ToBCD() doubles the high word
+// only if there is one and adds 1 per set bit, the division loop's
+// cost grows with the quotient: 0 and 9 the fastest, 65535 / 65536
+// either side of the high word, 67108863 (26 bits set) and 99999999,
+// the largest shown, the slowest.
+static const unsigned long bench_inputs[] = {
+    0, 9, 65535, 65536, 9999999, 67108863, 99999999
+};
+
+static void b_ShowDecNumber()
+{
+    ShowDecNumber(bench_number, 0, 0);
+}
+
+// Before the double dabble: a 32-bit division per digit
+static void b_ShowDecNumber_div()
+{
+    unsigned long number = bench_number;
+    unsigned int i;
+
+    for (i = 0; i < 6; i++)
+    {
+        ShowDig(7 - i, number % 10, 0);
+        number /= 10;
+    }
+}
+
+static void b_DisplayRefresh()
+{
+    ShowDecNumber(87654321, 0, 0);          // all eight digits dirty
+    DisplayRefresh();
+    SpiFlush();                             // until the last byte is out
+}
+
+static void b_GetKey()
+{
+    GetKey();
+}
+
+static void b_KeyScan()
+{
+    KeyScan();
+}
+
+static void b_ow_read_byte()
+{
+    ow_read_byte();
+}
+
+static void b_ow_crc8()
+{
+    ow_crc8(bench_pad, sizeof bench_pad);
+}
+
+static volatile int16_t bench_raw = -0x0191;    // -25.0625 degC
+static volatile long bench_centi;
+
+#if BENCH_FLOAT
+// Before ds18b20_centi(): GetData() gave a float magnitude, the caller
+// multiplied by 100. It truncates, 1440 of the 2881 inputs come out one
+// below the exact value (tools/numbench), so it is the cost reference
+// only, not the one ds18b20_centi() is checked against.
+static void b_centi_float()
+{
+    uint16_t temp = bench_raw;
+    float deg;
+
+    if (temp < 0x8000)
+        deg = (temp * 0.0625);
+    else
+    {
+        temp = (~temp) + 1;
+        deg = (temp * 0.0625);
+    }
+    bench_centi = deg * 100;
+}
+#endif
+
+static void b_centi_fixed()
+{
+    bench_centi = ds18b20_centi(bench_raw);
+}
+
+static void b_Timer0_A0()
+{
+    HAL_TICK_CCTL |= CCIFG;                 // taken after the next instruction
+    HAL_NOP();
+}
+
+static void (* const bench_fn[])() = {
+    b_empty, b_SendData, b_ShowDecNumber, b_ShowDecNumber_div,
+    b_DisplayRefresh, b_GetKey, b_KeyScan, b_ow_read_byte, b_ow_crc8,
+#if BENCH_FLOAT
+    b_centi_float,
+#endif
+    b_centi_fixed, b_Timer0_A0
+};
+
+bench_t bench_results[] = {
+    { "empty", "b_empty", 0, 0, 0, 0, 1, 0 },
+    { "SendData", "SendData", 0, 0, 0, 1, 0, 0 },
+    { "ShowDecNumber", "ShowDecNumber", 0, 0, 0, 0, 1, 1 },
+    { "ShowDecNumber_div", "b_ShowDecNumber_div", 0, 0, 0, 0, 1, 1 },
+    { "DisplayRefresh", "DisplayRefresh", 0, 0, 0, 1, 0, 0 },
+    { "GetKey", "GetKey", 0, 0, 0, 1, 0, 0 },
+    { "KeyScan", "KeyScan", 0, 0, 0, 1, 0, 0 },
+    { "ow_read_byte", "ow_read_byte", 0, 0, 0, 1, 0, 0 },
+    { "ow_crc8", "ow_crc8", 0, 0, 0, 0, 1, 0 },
+#if BENCH_FLOAT
+    { "centi_float", "b_centi_float", 0, 0, 0, 0, 1, 0 },
+#endif
+    { "centi_fixed", "ds18b20_centi", 0, 0, 0, 0, 1, 0 },
+    { "Timer0_A0", "Timer0_A0", 0, 0, 0, 0, 0, 0 }
+};
+
+const unsigned int bench_count = sizeof bench_results / sizeof bench_results[0];
+
+// Best of BENCH_RUNS calls in ticks, the deepest stack into r->stack
+static unsigned int bench_time(bench_t *r, void (*fn)())
+{
+    uint16_t *sp = (uint16_t *)HAL_SP();
+    uint16_t *low = (uint16_t *)HAL_STACK_LOW;
+    uint16_t *p;
+    unsigned int start, ticks, best, run;
+
+    best = 0xFFFF;
+    for (run = 0; run < BENCH_RUNS; run++)
+    {
+        for (p = low; p < sp; p++)
+            *p = BENCH_PAINT;
+        start = HAL_OW_TR;
+        fn();
+        ticks = HAL_OW_TR - start;
+        for (p = low; p < sp && *p == BENCH_PAINT; p++);
+        if (ticks < best)
+            best = ticks;
+        if ((sp - p) * 2 > r->stack)
+            r->stack = (sp - p) * 2;
+    }
+    return best;
+}
+
+static void bench_one(bench_t *r, void (*fn)())
+{
+    unsigned long number = bench_number;
+    unsigned int ticks, min, max, i, clocks;
+
+    clocks = HAL_CLOCK_CTL2;
+    if (!r->bus)
+        HAL_CLOCK_CTL2 &= ~DIVS_3;          // SMCLK = MCLK, a tick a cycle
+    r->stack = 0;
+    if (r->sweep)
+    {
+        min = 0xFFFF;
+        max = 0;
+        for (i = 0; i < sizeof bench_inputs / sizeof bench_inputs[0]; i++)
+        {
+            bench_number = bench_inputs[i];
+            ticks = bench_time(r, fn);
+            if (ticks < min)
+                min = ticks;
+            if (ticks > max)
+                max = ticks;
+        }
+        bench_number = number;
+    }
+    else
+        min = max = bench_time(r, fn);
+    HAL_CLOCK_CTL2 = clocks;
+    r->cycles = r->bus ? (unsigned long)min * CLOCK_SMCLK_DIV : min;
+    r->cycles_max = r->bus ? (unsigned long)max * CLOCK_SMCLK_DIV : max;
+}
+
+// Fill bench_results[], the "empty" call is subtracted from the others
+void bench_run()
+{
+    unsigned int keys = HAL_KEY_CCTL;
+    unsigned int i;
+
+    HAL_KEY_CCTL = 0;                       // no key scans in between
+    SpiFlush();                             // nothing on the SPI when SMCLK changes
+    for (i = 0; i < bench_count; i++)
+        if (!BENCH_SIM || bench_results[i].sim)
+            bench_one(&bench_results[i], bench_fn[i]);
+    for (i = 1; i < bench_count; i++)
+    {
+        bench_results[i].cycles -= bench_results[0].cycles;
+        bench_results[i].cycles_max -= bench_results[0].cycles;
+    }
+    HAL_KEY_CCTL = keys;
+}
+
+#if BENCH_SIM
+static void bench_puts(const char *s)
+{
+    while (*s)
+        BENCH_CONSOLE = *s++;
+}
+
+static void bench_putu(unsigned long n)
+{
+    char buf[11], *p = buf + sizeof buf;
+
+    *--p = 0;
+    do
+    {
+        *--p = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    bench_puts(p);
+}
+
+// Breakpoint of bench.mk, the results are all out
+void __attribute__((noinline)) bench_done()
+{
+    HAL_NOP();
+}
+
+// Simulator entry from main(), instead of the application
+void bench_sim()
+{
+    bench_t *r;
+    unsigned int i;
+
+    HAL_OW_TCTL = TASSEL_2 | MC_2;          // cycle counter, ow_portsetup() is not run
+    bench_run();
+    for (i = 1; i < bench_count; i++)
+    {
+        r = &bench_results[i];
+        if (!r->sim)
+            continue;
+        bench_puts("csv:");
+        bench_puts(r->name);
+        BENCH_CONSOLE = ',';
+        bench_puts(r->sym);
+        BENCH_CONSOLE = ',';
+        bench_putu(r->cycles);
+        BENCH_CONSOLE = ',';
+        bench_putu(r->cycles_max);
+        BENCH_CONSOLE = ',';
+        bench_putu(r->stack);
+        BENCH_CONSOLE = '\n';
+    }
+    while (1)
+        bench_done();
+}
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+// Build with --define=BENCH=1 to run the driver benchmarks at start-up.
+// BENCH_SIM=1 as well builds for mspdebug's simulator instead (bench.mk):
+// only the cases that need no USCI, 1-Wire or interrupts, printed as CSV.
+#ifndef BENCH
+#define BENCH 0
+#endif
+#ifndef BENCH_SIM
+#define BENCH_SIM 0
+#endif
+// BENCH_FLOAT=0 leaves the float centi case out, bench.mk's size target
+// builds both to show what the float path and its library cost
+#ifndef BENCH_FLOAT
+#define BENCH_FLOAT 1
+#endif
+
+typedef struct
+{
+    const char *name;
+    const char *sym;                        // function whose code is measured
+    unsigned long cycles;                   // MCLK cycles, best of BENCH_RUNS
+    unsigned long cycles_max;               // sweep: the slowest input's, else cycles
+    unsigned int stack;                     // bytes below the caller's SP
+    unsigned char bus;                      // waits on a bus, CLOCK_SMCLK_DIV resolution
+    unsigned char sim;                      // runs in mspdebug's simulator
+    unsigned char sweep;                    // over bench_inputs[], cycles is the fastest
+} bench_t;
+
+#define BENCH_RUNS      4
+
+extern bench_t bench_results[];
+extern const unsigned int bench_count;
+
+void bench_run();
+void bench_sim();
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,71 @@
+# Benchmarks in mspdebug's simulator, built with msp430-elf-gcc (TI's
+# MSP430 GCC). The CCS project does not use this file.
+#   make -f bench.mk            bench.csv
+#   make -f bench.mk size       .text of the build with and without the float path
+#   make -f bench.mk clean
+#
+# bench.csv, one line per case:
+#   case    bench_results[] name
+#   symbol  function whose code the case measures
+#   cycles  MCLK cycles, best of BENCH_RUNS calls, the empty call taken off
+#   cycles_max  the same for the slowest of bench_inputs[]; the sweep cases,
+#           ShowDecNumber (double dabble) and ShowDecNumber_div (division),
+#           run once per input and cycles is the fastest. Else cycles again.
+#   stack   bytes below the caller's SP, interrupt frames included
+#   text    bytes of symbol in bench.elf (nm -S), not counting what it calls
+#
+# Only the cases that need no USCI, 1-Wire bus or interrupts run (the
+# sim flag in bench.c), the simulator has no model of those; the others
+# stay with the on-target BENCH build and the debugger. The simulator
+# counts every instruction from its cycle table with MCLK = SMCLK, so the
+# cycles are those of the instruction set, without flash wait states or
+# interrupts. Timer1_A is its timer simio at 0x0180, the CSV comes out of
+# its console simio at 0x01F0 (BENCH_CONSOLE) and the run ends at the
+# breakpoint on bench_done().
+# size: bench.elf against bench_fixed.elf, built with BENCH_FLOAT=0. The
+# difference is the old float centi path with the soft float routines it
+# pulls in; the fixed point one, ds18b20_centi(), is in both and in the
+# text column of bench.csv.
+
+GCC_DIR  ?= /opt/ti/msp430-gcc
+CC       = msp430-elf-gcc
+NM       = msp430-elf-nm
+SIZE     = msp430-elf-size
+MSPDEBUG = mspdebug
+MCU      = msp430g2553
+
+CFLAGS   = -mmcu=$(MCU) -Os -g -Wall -I$(GCC_DIR)/include -DBENCH=1 -DBENCH_SIM=1
+LDFLAGS  = -mmcu=$(MCU) -L$(GCC_DIR)/include
+SRC      = main.c bench.c TM1638.c onewire.c ds18b20.c sched.c history.c trace.c
+
+all: bench.csv
+
+bench.elf: $(SRC) $(wildcard *.h) bench.mk
+	$(CC) $(CFLAGS) $(LDFLAGS) -o $@ $(SRC)
+
+bench_fixed.elf: $(SRC) $(wildcard *.h) bench.mk
+	$(CC) $(CFLAGS) -DBENCH_FLOAT=0 $(LDFLAGS) -o $@ $(SRC)
+
+size: bench.elf bench_fixed.elf
+	$(SIZE) bench.elf bench_fixed.elf
+	@$(SIZE) bench.elf bench_fixed.elf | awk 'NR > 1 { t[NR] = $$1 } \
+	    END { print "float path: " t[2] - t[3] " bytes of .text" }'
+
+bench.out: bench.elf
+	$(MSPDEBUG) -q sim \
+	    "simio add timer ta1" "simio config ta1 base 0x0180" \
+	    "simio add console con" "simio config con base 0x01F0" \
+	    "prog bench.elf" "setbreak bench_done" "run" > $@
+
+bench.csv: bench.out bench.elf
+	echo "case,symbol,cycles,cycles_max,stack,text" > $@
+	$(NM) -S --radix=d bench.elf | awk ' \
+	    FNR == NR { if (NF == 4) size[$$4] = $$2 + 0; next } \
+	    sub(/.*csv:/, "") { split($$0, f, ","); print $$0 "," size[f[2]] }' \
+	    - bench.out >> $@
+	cat $@
+
+clean:
+	rm -f bench.elf bench_fixed.elf bench.out bench.csv
+
+.PHONY: all size clean
@@ -0,0 +1,99 @@
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include "hal.h"
+
+// ##################### Clock profile ############################
+// The one place the clocks are set. Build with --define=CLOCK_MHZ=16
+// (1, 8, 12 or 16) and every delay, timer period, SPI divider and baud
+// rate follows from it; combinations that cannot be met stop the build.
+// The DCO runs at CLOCK_MHZ from the factory calibration and is never
+// retuned: SMCLK = DCO / CLOCK_SMCLK_DIV clocks the 1-Wire engine, the
+// SPI and the trace clock and stays put. MCLK has two run modes, the
+// full DCO for a burst of work and DCO / CLOCK_IDLE_DIV otherwise; the
+// main loop bursts while it has events and sleeps in LPM3 (DCO off)
+// when it has none. ACLK stays on the 32768Hz crystal.
+// 8MHz is the default, the G2553 runs it from 2.2V, which leaves room
+// on a draining battery. 16MHz is opt-in: it needs Vcc >= 3.3V
+// and nothing here checks the supply before a burst.
+
+#ifndef CLOCK_MHZ
+#define CLOCK_MHZ       8
+#endif
+
+#if CLOCK_MHZ == 1
+#define CLOCK_CALBC1    CALBC1_1MHZ
+#define CLOCK_CALDCO    CALDCO_1MHZ
+#elif CLOCK_MHZ == 8
+#define CLOCK_CALBC1    CALBC1_8MHZ
+#define CLOCK_CALDCO    CALDCO_8MHZ
+#elif CLOCK_MHZ == 12
+#define CLOCK_CALBC1    CALBC1_12MHZ
+#define CLOCK_CALDCO    CALDCO_12MHZ
+#elif CLOCK_MHZ == 16
+#define CLOCK_CALBC1    CALBC1_16MHZ
+#define CLOCK_CALDCO    CALDCO_16MHZ
+#else
+#error "CLOCK_MHZ: the DCO is calibrated for 1, 8, 12 and 16MHz only"
+#endif
+
+// SMCLK around 2MHz, MCLK between bursts the same by default
+#ifndef CLOCK_SMCLK_DIV
+#if CLOCK_MHZ >= 16
+#define CLOCK_SMCLK_DIV 8
+#elif CLOCK_MHZ >= 8
+#define CLOCK_SMCLK_DIV 4
+#else
+#define CLOCK_SMCLK_DIV 1
+#endif
+#endif
+#ifndef CLOCK_IDLE_DIV
+#define CLOCK_IDLE_DIV  CLOCK_SMCLK_DIV
+#endif
+
+#if CLOCK_SMCLK_DIV == 1
+#define CLOCK_DIVS      0x00    // DIVS_0
+#elif CLOCK_SMCLK_DIV == 2
+#define CLOCK_DIVS      0x02    // DIVS_1
+#elif CLOCK_SMCLK_DIV == 4
+#define CLOCK_DIVS      0x04    // DIVS_2
+#elif CLOCK_SMCLK_DIV == 8
+#define CLOCK_DIVS      0x06    // DIVS_3
+#else
+#error "CLOCK_SMCLK_DIV: 1, 2, 4 or 8"
+#endif
+
+#if CLOCK_IDLE_DIV == 1
+#define CLOCK_DIVM_IDLE 0x00    // DIVM_0
+#elif CLOCK_IDLE_DIV == 2
+#define CLOCK_DIVM_IDLE 0x10    // DIVM_1
+#elif CLOCK_IDLE_DIV == 4
+#define CLOCK_DIVM_IDLE 0x20    // DIVM_2
+#elif CLOCK_IDLE_DIV == 8
+#define CLOCK_DIVM_IDLE 0x30    // DIVM_3
+#else
+#error "CLOCK_IDLE_DIV: 1, 2, 4 or 8"
+#endif
+
+#define CLOCK_FREQ      (CLOCK_MHZ * 1000000L)  // DCO, MCLK in a burst, Hz
+#define CLOCK_SMCLK_FREQ (CLOCK_FREQ / CLOCK_SMCLK_DIV)
+#define CLOCK_IDLE_FREQ (CLOCK_FREQ / CLOCK_IDLE_DIV)
+#define CLOCK_ACLK_FREQ 32768L
+
+#if CLOCK_SMCLK_FREQ % 1000000L || CLOCK_IDLE_FREQ % 1000000L
+#error "CLOCK_SMCLK_DIV, CLOCK_IDLE_DIV: SMCLK and idle MCLK must be whole MHz"
+#endif
+
+// Dividers first, so MCLK starts out idle while the DCO settles
+#define CLOCK_INIT()    { HAL_CLOCK_CTL2 = CLOCK_DIVS | CLOCK_DIVM_IDLE; HAL_CLOCK_DCO = 0; \
+                          HAL_CLOCK_CTL1 = CLOCK_CALBC1; HAL_CLOCK_DCO = CLOCK_CALDCO; }
+
+// Run modes, MCLK only. A burst in an ISR saves and restores the mode
+// of whatever it interrupted.
+#define CLOCK_BURST()   (HAL_CLOCK_CTL2 &= ~DIVM_3)
+#define CLOCK_IDLE()    (HAL_CLOCK_CTL2 |= CLOCK_DIVM_IDLE)
+#define CLOCK_BURSTING() (!(HAL_CLOCK_CTL2 & DIVM_3))
+#define CLOCK_SAVE()    (HAL_CLOCK_CTL2)
+#define CLOCK_RESTORE(s) (HAL_CLOCK_CTL2 = (s))
+
+#endif /* CLOCK_H_ */
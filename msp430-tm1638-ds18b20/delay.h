@@ -1,10 +1,24 @@
 #ifndef DELAY_H_
 #define DELAY_H_
 
-#define CYCLES_PER_US 1L // depends on the CPU speed
+#include "hal.h"
+#include "clock.h"
+
+// MCLK cycles per us in a burst and between bursts, from clock.h. The
+// delays check the run mode, so bit timing holds in either.
+#define CYCLES_PER_US (CLOCK_MHZ * 1L)
 #define CYCLES_PER_MS (CYCLES_PER_US * 1000L)
+#define CYCLES_IDLE_US (CLOCK_IDLE_FREQ / 1000000L)
+#define CYCLES_IDLE_MS (CYCLES_IDLE_US * 1000L)
 
-#define DELAY_US(x) __delay_cycles((x * CYCLES_PER_US))
-#define DELAY_MS(x) __delay_cycles((x * CYCLES_PER_MS))
+#if CLOCK_IDLE_DIV == 1
+#define DELAY_US(x) HAL_DELAY_CYCLES((x * CYCLES_PER_US))
+#define DELAY_MS(x) HAL_DELAY_CYCLES((x * CYCLES_PER_MS))
+#else
+#define DELAY_US(x) do { if (CLOCK_BURSTING()) HAL_DELAY_CYCLES((x * CYCLES_PER_US)); \
+                         else HAL_DELAY_CYCLES((x * CYCLES_IDLE_US)); } while (0)
+#define DELAY_MS(x) do { if (CLOCK_BURSTING()) HAL_DELAY_CYCLES((x * CYCLES_PER_MS)); \
+                         else HAL_DELAY_CYCLES((x * CYCLES_IDLE_MS)); } while (0)
+#endif
 
 #endif /* DELAY_H_ */
@@ -0,0 +1,368 @@
+#include "hal.h"
+#include "stdint.h"
+#include "onewire.h"
+#include "ds18b20.h"
+
+// ##################### DS18B20 ################################
+// Conversions run in the background: ds18b20_start() broadcasts CONVERT_T
+// to all sensors through the 1-Wire engine and arms Timer0_A CCR1, the
+// CCR1 interrupt starts the MATCHROM scratchpad reads one sensor after
+// the other and the last one starts the next conversion. GetData() and
+// ds18b20_temp() only return cached values.
+// A resolution change is written to each sensor with MATCHROM (and
+// optionally copied to its EEPROM) in front of the next conversion.
+// The alarm bytes TH / TL go back unchanged, so a sensor is only written
+// once a CRC-valid scratchpad read has given its own; until then it keeps
+// converting at whatever resolution it has. The conversion wait is that of
+// the slowest sensor, 94/188/375/750 ms for 9..12 bits, each one's taken
+// from the config byte of its last read, 12 bits while there is none.
+// A bus error (no sensor, line held low) waits one conversion time on
+// CCR1 before the next try, so a dead bus still lets main sleep.
+
+static volatile unsigned char conv_state = DS18B20_IDLE;
+static volatile unsigned char conv_fresh;   // new values since last poll
+static int16_t temps[DS18B20_MAX_SENSORS];  // last scratchpad temperatures
+static uint8_t roms[DS18B20_MAX_SENSORS][8];
+static unsigned char sensors;               // ROMs found by ds18b20_search()
+static unsigned char current;               // sensor being read
+
+static const uint8_t conv_cmd[] = { DS1820_SKIP_ROM, DS1820_CONVERT_T };
+static uint8_t read_cmd[10];                // MATCHROM, ROM, READ_SCRATCHPAD
+static uint8_t scratchpad[9];
+static unsigned char retries = DS18B20_RETRIES;
+
+static unsigned char resolution = 12;       // bits, 9..12
+static volatile unsigned char cfg_pending;  // write resolution before next conversion
+static volatile unsigned char cfg_save;     // and copy it to EEPROM
+static unsigned char cfg_copy;              // cfg_save taken for this round of writes
+static unsigned char cfg_index;             // sensor being written
+static unsigned char adaptive;              // pick resolution from the trend
+static unsigned char moving;                // a sensor changed this cycle
+static unsigned char stable;                // cycles without change
+static uint8_t cfg_cmd[13];                 // MATCHROM, ROM, WRITE_SCRATCHPAD, TH, TL, config
+static uint8_t alarms[DS18B20_MAX_SENSORS][2]; // TH / TL from the last good read
+static uint8_t alarms_valid;                // bit n: alarms[n] came from a valid read
+static uint8_t sensor_bits[DS18B20_MAX_SENSORS]; // resolution read back, 0 - not yet
+
+// Fixed scratchpad bits, checked by the engine as the bytes arrive:
+// config register 0RR11111, reserved bytes FFh and 10h
+static const uint8_t pad_mask[9] =  { 0, 0, 0, 0, 0x9F, 0xFF, 0, 0xFF, 0 };
+static const uint8_t pad_value[9] = { 0, 0, 0, 0, 0x1F, 0xFF, 0, 0x10, 0 };
+
+static void read_next();
+static void cfg_next();
+
+// MATCHROM and the ROM of sensor n in front of a function command,
+// SKIP_ROM if the search found none. Returns the bytes written.
+static unsigned int address(uint8_t *cmd, unsigned int n)
+{
+    unsigned int i;
+
+    if (!sensors)
+    {
+        cmd[0] = DS1820_SKIP_ROM;
+        return 1;
+    }
+    cmd[0] = DS1820_MATCHROM;
+    for (i = 0; i < 8; i++)
+        cmd[i + 1] = roms[n][i];
+    return 9;
+}
+
+// Arm Timer0_A CCR1, it counts up to TACCR0 so wrap the compare value there
+static void arm_timer(unsigned int ticks)
+{
+    unsigned int ccr;
+
+    ccr = HAL_TICK_R + ticks;
+    if (ccr > HAL_TICK_TOP)
+        ccr -= HAL_TICK_TOP + 1;
+    HAL_CONV_CCR = ccr;
+    HAL_CONV_CCTL = CCIE;
+}
+
+// Resolution of the slowest sensor, its conversion takes the longest
+static unsigned int conv_bits()
+{
+    unsigned int i, bits = 9;
+
+    for (i = 0; i < (sensors ? sensors : 1); i++)
+    {
+        if (!sensor_bits[i])
+            return 12;                      // not read yet, may be anything
+        if (sensor_bits[i] > bits)
+            bits = sensor_bits[i];
+    }
+    return bits;
+}
+
+// Transfer failed: try again after DS18B20_RETRY_TICKS
+static void backoff()
+{
+    if (conv_state == DS18B20_WRITING || conv_state == DS18B20_SAVING)
+    {
+        cfg_pending = 1;                    // start the writes over
+        cfg_save |= cfg_copy;
+    }
+    conv_state = DS18B20_BACKOFF;
+    arm_timer(DS18B20_RETRY_TICKS);
+}
+
+static void conv_started(int status)
+{
+    if (status)
+    {
+        backoff();                          // no sensor, retried by the timer
+        return;
+    }
+    OW_HI                                   // strong pull-up while converting
+    arm_timer(DS18B20_CONV_TICKS >> (12 - conv_bits()));
+}
+
+static void cfg_copied(int status)
+{
+    if (status)
+    {
+        backoff();
+        return;
+    }
+    OW_HI                                   // strong pull-up while copying
+    conv_state = DS18B20_SAVING;
+    arm_timer(DS18B20_COPY_TICKS);
+}
+
+static void cfg_written(int status)
+{
+    unsigned int len;
+
+    if (status)
+    {
+        backoff();
+        return;
+    }
+    sensor_bits[cfg_index] = resolution;    // converts at it from now on
+    if (cfg_copy)
+    {
+        len = address(cfg_cmd, cfg_index);
+        cfg_cmd[len] = DS1820_COPY_SCRATCHPAD;
+        if (ow_transfer(1, cfg_cmd, (len + 1) * 8, 0, 0, cfg_copied))
+            backoff();
+        return;
+    }
+    cfg_index++;
+    cfg_next();
+}
+
+// Write the resolution to the next sensor with valid TH / TL, the others
+// keep their configuration. Convert when all are done.
+static void cfg_next()
+{
+    unsigned int len;
+
+    while (cfg_index < DS18B20_MAX_SENSORS && !(alarms_valid & (1 << cfg_index)))
+        cfg_index++;
+    if (cfg_index >= DS18B20_MAX_SENSORS)
+    {
+        ds18b20_start();
+        return;
+    }
+    conv_state = DS18B20_WRITING;
+    len = address(cfg_cmd, cfg_index);
+    cfg_cmd[len] = DS1820_WRITE_SCRATCHPAD;
+    cfg_cmd[len + 1] = alarms[cfg_index][0];
+    cfg_cmd[len + 2] = alarms[cfg_index][1];
+    cfg_cmd[len + 3] = 0x1F | ((resolution - 9) << 5);
+    if (ow_transfer(1, cfg_cmd, (len + 4) * 8, 0, 0, cfg_written))
+        backoff();
+}
+
+// Adaptive mode: 9 bits while any sensor moves, 12 bits once all are stable
+static void adapt()
+{
+    if (moving)
+    {
+        stable = 0;
+        if (resolution != 9)
+            ds18b20_resolution(9);
+    }
+    else if (stable < DS18B20_ADAPT_STABLE)
+        stable++;
+    else if (resolution != 12)
+        ds18b20_resolution(12);
+    moving = 0;
+}
+
+static void read_done(int status)
+{
+    int16_t temp;
+
+    if (status == OW_OK && !ow_crc())       // CRC over all 9 bytes
+    {
+        // the config byte has the resolution of this conversion, the
+        // temperature bits below it are undefined
+        sensor_bits[current] = 9 + ((scratchpad[4] >> 5) & 3);
+        temp = (scratchpad[0] | (scratchpad[1] << 8))
+                & (0xFFFF << (12 - sensor_bits[current]));
+        if (temp - temps[current] > DS18B20_ADAPT_DELTA
+                || temps[current] - temp > DS18B20_ADAPT_DELTA)
+            moving = 1;
+        temps[current] = temp;
+        alarms[current][0] = scratchpad[2];
+        alarms[current][1] = scratchpad[3];
+        alarms_valid |= 1 << current;
+    }
+    else if (retries)
+    {
+        retries--;                          // scratchpad still holds the value
+        read_next();
+        return;
+    }
+    retries = DS18B20_RETRIES;
+    if (++current < sensors)
+    {
+        read_next();
+        return;
+    }
+    conv_fresh = 1;
+    if (adaptive)
+        adapt();
+    ds18b20_start();
+}
+
+// Read scratchpad of sensor [current]
+static void read_next()
+{
+    unsigned int len;
+
+    len = address(read_cmd, current);
+    read_cmd[len] = DS1820_READ_SCRATCHPAD;
+    ow_expect(pad_mask, pad_value);
+    if (ow_transfer(1, read_cmd, (len + 1) * 8, scratchpad, 72, read_done))
+        backoff();
+}
+
+// Enumerate the bus, call before the first ds18b20_poll()
+unsigned int ds18b20_search()
+{
+    unsigned int i;
+
+    sensors = ow_search(roms, DS18B20_MAX_SENSORS);
+    alarms_valid = 0;                       // indices may now be other sensors
+    for (i = 0; i < DS18B20_MAX_SENSORS; i++)
+        sensor_bits[i] = 0;
+    return sensors;
+}
+
+unsigned int ds18b20_sensors()
+{
+    return sensors;
+}
+
+// Resolution 9..12 bits for all sensors, written before the next conversion
+void ds18b20_resolution(unsigned int bits)
+{
+    if (bits < 9)
+        bits = 9;
+    if (bits > 12)
+        bits = 12;
+    resolution = bits;
+    cfg_pending = 1;
+}
+
+// Also copy the next resolution write to the sensors' EEPROM, each one
+// after its own write
+void ds18b20_save()
+{
+    cfg_save = 1;
+    cfg_pending = 1;
+}
+
+unsigned int ds18b20_get_resolution()
+{
+    return resolution;
+}
+
+void ds18b20_adaptive(int on)
+{
+    adaptive = on;
+    stable = 0;
+    moving = 0;
+}
+
+void ds18b20_start()
+{
+    int err;
+
+    if (cfg_pending && alarms_valid)        // TH / TL known for some sensor
+    {
+        cfg_pending = 0;
+        cfg_copy = cfg_save;
+        cfg_save = 0;
+        cfg_index = 0;
+        cfg_next();
+        return;
+    }
+    conv_state = DS18B20_CONVERTING;
+    err = ow_transfer(1, conv_cmd, 16, 0, 0, conv_started);
+    if (err)
+        backoff();
+}
+
+// Called from the Timer0_A1 interrupt when CCR1 matches
+void ds18b20_timer()
+{
+    HAL_CONV_CCTL = 0;
+    if (conv_state == DS18B20_SAVING)
+    {
+        cfg_index++;                        // EEPROM written, next sensor
+        cfg_next();
+        return;
+    }
+    if (conv_state == DS18B20_BACKOFF)
+    {
+        ds18b20_start();                    // retry
+        return;
+    }
+    conv_state = DS18B20_READING;
+    current = 0;
+    read_next();
+}
+
+// Returns 1 when a new temperature has been read. Starts the first
+// conversion, later ones and retries start from the pipeline itself.
+int ds18b20_poll()
+{
+    if (conv_state == DS18B20_IDLE)
+        ds18b20_start();
+    if (!conv_fresh)
+        return 0;
+    conv_fresh = 0;
+    return 1;
+}
+
+// Last temperature of sensor n, 1/16 degC steps (scratchpad format)
+int16_t ds18b20_temp(unsigned int n)
+{
+    return temps[n];
+}
+
+int16_t GetData(void)
+{
+    return temps[0];
+}
+
+// Fraction of a degree in 1/100 degC for each 1/16 degC step
+static const uint8_t frac_centi[16] = {
+    0, 6, 13, 19, 25, 31, 38, 44, 50, 56, 63, 69, 75, 81, 88, 94
+};
+
+// 1/16 degC -> 1/100 degC without multiply or divide by 16ths
+int ds18b20_centi(int16_t temp)
+{
+    unsigned int mag;
+    int centi;
+
+    mag = (temp < 0) ? -temp : temp;
+    centi = (mag >> 4) * 100 + frac_centi[mag & 0x0F];
+    return (temp < 0) ? -centi : centi;
+}
@@ -0,0 +1,39 @@
+#ifndef DS18B20_H_
+#define DS18B20_H_
+#include <stdint.h>
+
+// Conversion pipeline states:
+#define DS18B20_IDLE        0   // no conversion running
+#define DS18B20_CONVERTING  1   // CONVERT_T issued, Timer0_A CCR1 armed
+#define DS18B20_READING     2   // scratchpad read running on the 1-Wire engine
+#define DS18B20_SAVING      3   // COPY_SCRATCHPAD issued, Timer0_A CCR1 armed
+#define DS18B20_BACKOFF     4   // 1-Wire error, Timer0_A CCR1 armed for the retry
+#define DS18B20_WRITING     5   // resolution written to one sensor after the other
+
+#define DS18B20_MAX_SENSORS 8   // ROMs kept from the search
+#define DS18B20_RETRIES     2   // scratchpad re-reads after a CRC error
+#define DS18B20_ADAPT_DELTA 8   // 1/16 degC change that counts as moving
+#define DS18B20_ADAPT_STABLE 4  // quiet cycles before going back to 12 bits
+
+// Conversion time in Timer0_A ticks (ACLK = 32768 Hz):
+#define DS18B20_CONV_TICKS  ((750L * 32768) / 1000) // 750 ms for 12-bit resolution,
+                                                    // halved per bit less
+#define DS18B20_COPY_TICKS  ((10L * 32768) / 1000)  // 10 ms EEPROM write
+#define DS18B20_RETRY_TICKS DS18B20_CONV_TICKS      // wait after no presence / bus low
+
+// Function definitions:
+
+unsigned int ds18b20_search();
+unsigned int ds18b20_sensors();
+void ds18b20_resolution(unsigned int bits);
+void ds18b20_save();
+unsigned int ds18b20_get_resolution();
+void ds18b20_adaptive(int on);
+void ds18b20_start();
+int ds18b20_poll();
+void ds18b20_timer();
+int16_t ds18b20_temp(unsigned int n);
+int16_t GetData(void);
+int ds18b20_centi(int16_t temp);
+
+#endif /* DS18B20_H_ */
@@ -0,0 +1,182 @@
+#ifndef HAL_H_
+#define HAL_H_
+
+// ##################### Register layer ###########################
+// Every register the drivers and main.c touch is named here, together
+// with the core intrinsics and the interrupt vector declaration; no
+// other file includes the device header. Moving a peripheral to other
+// pins or another timer only needs a different hal.h. Built with
+// --define=HAL_SIM the names resolve to the register models of the
+// host simulator in tools/sim instead of the device header.
+
+#ifdef HAL_SIM
+#include "msp430sim.h"
+#else
+#include "msp430g2553.h"
+#endif
+
+// ##### Core: interrupts, low power modes, cycles #####
+#define HAL_INT_STATE()     __get_interrupt_state()
+#define HAL_INT_RESTORE(s)  __set_interrupt_state(s)
+#define HAL_INT_OFF()       __disable_interrupt()
+#define HAL_INT_ON()        __enable_interrupt()
+#define HAL_SLEEP(lpm)      __bis_SR_register((lpm) + GIE)  // until an ISR wakes it
+#define HAL_WAKE()          __bic_SR_register_on_exit(LPM3_bits) // from an ISR: no LPM after it
+#define HAL_DELAY_CYCLES(n) __delay_cycles(n)                // MCLK, n a constant
+#define HAL_NOP()           __no_operation()
+#define HAL_SP()            __get_SP_register()
+#ifdef __TI_COMPILER_VERSION__
+#define HAL_BCD_ADD_LONG(a, b) __bcd_add_long((a), (b))     // DADD
+#endif
+// Lowest word of the stack, from the linker
+#if defined(__TI_COMPILER_VERSION__)
+extern char __STACK_END, __STACK_SIZE;
+#define HAL_STACK_LOW       ((unsigned int *) (&__STACK_END - (unsigned int) &__STACK_SIZE))
+#elif defined(__GNUC__) && defined(__MSP430__)
+extern char end;                            // above .bss, the heap is unused
+#define HAL_STACK_LOW       ((unsigned int *) (((unsigned int) &end + 1) & ~1u))
+#endif
+
+// Interrupt service routine for vector vec
+#define HAL_PRAGMA(x)       _Pragma(#x)
+#if defined(HAL_SIM)
+#define HAL_ISR(vec, name)  SIM_ISR(vec, name)
+#elif defined(__GNUC__) && defined(__MSP430__)
+#define HAL_ISR(vec, name)  void __attribute__((interrupt(vec))) name(void)
+#else
+#define HAL_ISR(vec, name)  HAL_PRAGMA(vector = vec) __interrupt void name(void)
+#endif
+
+// ##### Clock system and watchdog, clock.h #####
+#define HAL_CLOCK_CTL1      BCSCTL1
+#define HAL_CLOCK_CTL2      BCSCTL2
+#define HAL_CLOCK_DCO       DCOCTL
+#define HAL_WDT_CTL         WDTCTL
+
+// ##### Board LEDs on P1.0 and P1.6, 1 Hz toggle on P1.1 #####
+#define HAL_LED_DIR         P1DIR
+#define HAL_LED_OUT         P1OUT
+#define HAL_BEAT_OUT        P1OUT
+#define HAL_BEAT_PIN        BIT1            // an SPI/UART pin, so no effect
+
+// 1-Wire backend, build with --define=OW_UART=1 for the UART one:
+//  0 - bit engine on Timer1_A, TM1638 on USCI_A0
+//  1 - slots made by USCI_A0 as a UART, TM1638 moves to USCI_B0
+#ifndef OW_UART
+#define OW_UART 0
+#endif
+
+#if !OW_UART
+// ##### TM1638: USCI_A0 SPI master, P1.1/P1.2 DIO, P1.4 CLK, STROBE on P1.5 #####
+#define HAL_STROBE_DIR      P1DIR
+#define HAL_STROBE_OUT      P1OUT
+#define HAL_STROBE_PIN      BIT5
+#define HAL_SPI_SEL         P1SEL
+#define HAL_SPI_SEL2        P1SEL2
+#define HAL_SPI_PINS        (BIT1 | BIT2 | BIT4)    // HAL_SPI_SEL and HAL_SPI_SEL2
+#define HAL_SPI_CTL0        UCA0CTL0
+#define HAL_SPI_CTL1        UCA0CTL1
+#define HAL_SPI_BR0         UCA0BR0
+#define HAL_SPI_BR1         UCA0BR1
+#define HAL_SPI_MCTL        UCA0MCTL
+#define HAL_SPI_TXBUF       UCA0TXBUF
+#define HAL_SPI_RXBUF       UCA0RXBUF
+#define HAL_SPI_TX_READY    (IFG2 & UCA0TXIFG)
+#define HAL_SPI_RX_READY    (IFG2 & UCA0RXIFG)
+#define HAL_SPI_BUSY        (UCA0STAT & UCBUSY)
+#define HAL_SPI_TXIE_ON     (IE2 |= UCA0TXIE)
+#define HAL_SPI_TXIE_OFF    (IE2 &= ~UCA0TXIE)
+#define HAL_SPI_RXIE_ON     (IE2 |= UCA0RXIE)
+#define HAL_SPI_RXIE_OFF    (IE2 &= ~UCA0RXIE)
+#define HAL_SPI_TX_PENDING  (IE2 & IFG2 & UCA0TXIFG)    // enabled and flagged
+#define HAL_SPI_RX_PENDING  (IE2 & IFG2 & UCA0RXIFG)
+#define HAL_SPI_VECTOR      USCIAB0TX_VECTOR
+#define HAL_SPI_RX_VECTOR   USCIAB0RX_VECTOR
+#else
+// ##### TM1638: USCI_B0 SPI master, P1.6/P1.7 DIO, P1.5 CLK, STROBE on P1.4 #####
+#define HAL_STROBE_DIR      P1DIR
+#define HAL_STROBE_OUT      P1OUT
+#define HAL_STROBE_PIN      BIT4
+#define HAL_SPI_SEL         P1SEL
+#define HAL_SPI_SEL2        P1SEL2
+#define HAL_SPI_PINS        (BIT5 | BIT6 | BIT7)
+#define HAL_SPI_CTL0        UCB0CTL0
+#define HAL_SPI_CTL1        UCB0CTL1
+#define HAL_SPI_BR0         UCB0BR0
+#define HAL_SPI_BR1         UCB0BR1
+#define HAL_SPI_TXBUF       UCB0TXBUF
+#define HAL_SPI_RXBUF       UCB0RXBUF
+#define HAL_SPI_TX_READY    (IFG2 & UCB0TXIFG)
+#define HAL_SPI_RX_READY    (IFG2 & UCB0RXIFG)
+#define HAL_SPI_BUSY        (UCB0STAT & UCBUSY)
+#define HAL_SPI_TXIE_ON     (IE2 |= UCB0TXIE)
+#define HAL_SPI_TXIE_OFF    (IE2 &= ~UCB0TXIE)
+#define HAL_SPI_RXIE_ON     (IE2 |= UCB0RXIE)
+#define HAL_SPI_RXIE_OFF    (IE2 &= ~UCB0RXIE)
+#define HAL_SPI_TX_PENDING  (IE2 & IFG2 & UCB0TXIFG)
+#define HAL_SPI_RX_PENDING  (IE2 & IFG2 & UCB0RXIFG)
+#define HAL_SPI_VECTOR      USCIAB0TX_VECTOR
+#define HAL_SPI_RX_VECTOR   USCIAB0RX_VECTOR        // shared with HAL_OWU_VECTOR
+
+// ##### 1-Wire UART: USCI_A0, P1.1 RXD on DQ, P1.2 TXD to DQ through a diode #####
+#define HAL_OWU_SEL         P1SEL
+#define HAL_OWU_SEL2        P1SEL2
+#define HAL_OWU_PINS        (BIT1 | BIT2)           // HAL_OWU_SEL and HAL_OWU_SEL2
+#define HAL_OWU_CTL1        UCA0CTL1
+#define HAL_OWU_BR0         UCA0BR0
+#define HAL_OWU_BR1         UCA0BR1
+#define HAL_OWU_MCTL        UCA0MCTL
+#define HAL_OWU_STAT        UCA0STAT
+#define HAL_OWU_TXBUF       UCA0TXBUF
+#define HAL_OWU_RXBUF       UCA0RXBUF
+#define HAL_OWU_RXIE_ON     (IE2 |= UCA0RXIE)
+#define HAL_OWU_RXIE_OFF    (IE2 &= ~UCA0RXIE)
+#define HAL_OWU_RX_PENDING  (IE2 & IFG2 & UCA0RXIFG)
+#define HAL_OWU_VECTOR      USCIAB0RX_VECTOR
+#endif
+
+// ##### Timer0_A: ACLK, up mode, CCR0 = 1 Hz clock #####
+#define HAL_TICK_CTL        TACTL
+#define HAL_TICK_R          TAR
+#define HAL_TICK_TOP        TACCR0
+#define HAL_TICK_CCTL       TACCTL0
+#define HAL_TICK_IV         TA0IV           // CCR1, CCR2
+#define HAL_TICK_VECTOR     TIMER0_A0_VECTOR
+#define HAL_TICK_CC_VECTOR  TIMER0_A1_VECTOR
+#define HAL_CONV_CCR        TACCR1          // DS18B20 conversion / copy wait
+#define HAL_CONV_CCTL       TACCTL1
+#define HAL_KEY_CCR         TACCR2          // keypad scan period
+#define HAL_KEY_CCTL        TACCTL2
+
+// ##### 1-Wire: P2.3, TA1.0/CCI0B while a transfer runs #####
+// With OW_UART P2.3 stays on DQ only for the strong pull-up
+#define OWPORTDIR           P2DIR
+#define OWPORTOUT           P2OUT
+#define OWPORTIN            P2IN
+#define OWPORTREN           P2REN
+#define OWPORTSEL           P2SEL
+#define OWPORTPIN           BIT3
+
+// ##### Timer1_A: SMCLK, continuous mode, CCR0 = 1-Wire bit engine #####
+// With OW_UART it only counts, for trace.h and bench.c
+#define HAL_OW_TCTL         TA1CTL
+#define HAL_OW_TR           TA1R
+#define HAL_OW_CCR          TA1CCR0
+#define HAL_OW_CCTL         TA1CCTL0
+#define HAL_OW_VECTOR       TIMER1_A0_VECTOR
+#define HAL_OW_IV           TA1IV
+#define HAL_OW_WRAP_VECTOR  TIMER1_A1_VECTOR // overflow, counted for trace.h
+
+// ##### Flash controller, history log in info segments D, C, B #####
+// Info A holds the DCO calibration and stays locked (LOCKA)
+#define HAL_FLASH_CTL1      FCTL1
+#define HAL_FLASH_CTL2      FCTL2
+#define HAL_FLASH_CTL3      FCTL3
+#ifdef HAL_SIM
+#define HAL_HIST_BASE       SIM_INFO_MEM    // flash model, same layout
+#else
+#define HAL_HIST_BASE       ((unsigned char *) 0x1000) // info D, then C and B
+#endif
+#define HAL_HIST_SEG_SIZE   64
+
+#endif /* HAL_H_ */
@@ -0,0 +1,213 @@
+#include "hal.h"
+#include "stdint.h"
+#include "clock.h"
+#include "history.h"
+
+// Flash timing generator on SMCLK, which does not change with the run
+// mode, divided into 257..476kHz
+#define HIST_FN         ((CLOCK_SMCLK_FREQ + 475999L) / 476000L - 1)
+#if HIST_FN > 63 || CLOCK_SMCLK_FREQ / (HIST_FN + 1) < 257000L
+#error "CLOCK_SMCLK_DIV: no flash timing generator divider for this SMCLK"
+#endif
+
+#define HIST_SEG(n)     (HAL_HIST_BASE + (n) * HAL_HIST_SEG_SIZE)
+#define HIST_ERASED     0xFF
+#define HIST_SEQS       255     // sequence numbers, 0xFF is erased flash
+
+static int16_t samples[HIST_BATCH];         // RAM tier, oldest first
+static unsigned char nsamples;
+static unsigned char seg;                   // newest flash segment
+static unsigned char seq;                   // its sequence number
+static unsigned char pos;                   // next batch in it,
+                                            // HAL_HIST_SEG_SIZE: open the next
+
+// Zigzag varint of v to p, or only counted with p 0. Returns its bytes.
+static unsigned int put_varint(unsigned char *p, int16_t v)
+{
+    unsigned int z = ((unsigned int) v << 1) ^ (unsigned int) (v >> 15);
+    unsigned int n = 1;
+
+    while (z >= 0x80)
+    {
+        if (p)
+            *p++ = z | 0x80;
+        z >>= 7;
+        n++;
+    }
+    if (p)
+        *p = z;
+    return n;
+}
+
+// Zigzag varint at p, not past end. Returns the byte after it, 0 if cut off.
+static const unsigned char *get_varint(const unsigned char *p,
+        const unsigned char *end, int16_t *v)
+{
+    unsigned int z = 0, shift = 0;
+
+    do
+    {
+        if (p == end || shift > 14)
+            return 0;
+        z |= (unsigned int) (*p & 0x7F) << shift;
+        shift += 7;
+    } while (*p++ & 0x80);
+    *v = (int16_t) ((z >> 1) ^ -(z & 1));
+    return p;
+}
+
+// RAM batch as first sample and deltas, to p (flash with WRT set) or
+// only counted with p 0
+static unsigned int hist_encode(unsigned char *p)
+{
+    unsigned int i, n = 0;
+    int16_t prev = 0;
+
+    for (i = 0; i < nsamples; i++)
+    {
+        n += put_varint(p ? p + n : 0, samples[i] - prev);
+        prev = samples[i];
+    }
+    return n;
+}
+
+static void hist_acc(hist_stats_t *s, long *sum, int16_t v)
+{
+    if (!s->count || v < s->min)
+        s->min = v;
+    if (!s->count || v > s->max)
+        s->max = v;
+    *sum += v;
+    s->count++;
+}
+
+static int hist_valid(unsigned int n)
+{
+    return HIST_SEG(n)[0] == HIST_MAGIC && HIST_SEG(n)[1] < HIST_SEQS;
+}
+
+// Decode the batches of segment n into s (0: only find the end). Returns
+// the offset after the last batch, HAL_HIST_SEG_SIZE if it is damaged.
+static unsigned int hist_walk(unsigned int n, hist_stats_t *s, long *sum)
+{
+    const unsigned char *base = HIST_SEG(n), *end = base + HAL_HIST_SEG_SIZE;
+    const unsigned char *p = base + HIST_HEADER;
+    unsigned int i, count;
+    int16_t v, d;
+
+    while (p < end && (count = *p) != HIST_ERASED)
+    {
+        if (count == 0 || count > HIST_BATCH)
+            return HAL_HIST_SEG_SIZE;
+        p++;
+        v = 0;
+        for (i = 0; i < count; i++)
+        {
+            p = get_varint(p, end, &d);
+            if (!p)
+                return HAL_HIST_SEG_SIZE;
+            v += d;
+            if (s)
+                hist_acc(s, sum, v);
+        }
+    }
+    return p - base;
+}
+
+// Find the newest segment and the end of its batches, call once at start
+void hist_init()
+{
+    const unsigned char *p;
+    unsigned int i, j;
+
+    nsamples = 0;
+    seg = HIST_SEGS - 1;                    // nothing yet: the first batch
+    seq = HIST_SEQS - 1;                    // opens segment 0, sequence 0
+    pos = HAL_HIST_SEG_SIZE;
+    for (i = 0; i < HIST_SEGS; i++)
+    {
+        if (!hist_valid(i))
+            continue;
+        for (j = 0; j < HIST_SEGS; j++)     // newest: no segment follows it
+            if (j != i && hist_valid(j)
+                    && HIST_SEG(j)[1] == (HIST_SEG(i)[1] + 1) % HIST_SEQS)
+                break;
+        if (j < HIST_SEGS)
+            continue;
+        seg = i;
+        seq = HIST_SEG(i)[1];
+        pos = hist_walk(i, 0, 0);
+        // Programming cut off by a reset: never write over it
+        for (p = HIST_SEG(i) + pos; p < HIST_SEG(i) + HAL_HIST_SEG_SIZE; p++)
+            if (*p != HIST_ERASED)
+                pos = HAL_HIST_SEG_SIZE;
+        break;
+    }
+}
+
+// Keep a sample in RAM, dropped while the batch waits for hist_flush()
+void hist_add(int16_t temp)
+{
+    if (nsamples < HIST_BATCH)
+        samples[nsamples++] = temp;
+}
+
+int hist_full()
+{
+    return nsamples == HIST_BATCH;
+}
+
+// Write the RAM batch to flash. The CPU stops while the flash is busy
+// and interrupts are off, up to ~13ms when a segment is erased: call it
+// when no transfer needs interrupts.
+void hist_flush()
+{
+    unsigned short state;
+    unsigned int len;
+    unsigned char *p;
+
+    if (!nsamples)
+        return;
+    len = 1 + hist_encode(0);
+    state = HAL_INT_STATE();
+    HAL_INT_OFF();
+    HAL_FLASH_CTL2 = FWKEY | FSSEL_2 | HIST_FN;
+    HAL_FLASH_CTL3 = FWKEY;                 // unlock, LOCKA unchanged
+    if (pos + len > HAL_HIST_SEG_SIZE)
+    { // Next segment of the ring, its batches are the oldest
+        seg = (seg + 1) % HIST_SEGS;
+        seq = (seq + 1) % HIST_SEQS;
+        p = HIST_SEG(seg);
+        HAL_FLASH_CTL1 = FWKEY | ERASE;
+        *p = 0;                             // dummy write starts the erase
+        HAL_FLASH_CTL1 = FWKEY | WRT;
+        p[0] = HIST_MAGIC;
+        p[1] = seq;
+        pos = HIST_HEADER;
+    }
+    HAL_FLASH_CTL1 = FWKEY | WRT;
+    p = HIST_SEG(seg) + pos;
+    hist_encode(p + 1);
+    *p = nsamples;                          // count last: commits the batch
+    HAL_FLASH_CTL1 = FWKEY;
+    HAL_FLASH_CTL3 = FWKEY | LOCK;
+    HAL_INT_RESTORE(state);
+    pos += len;
+    nsamples = 0;
+}
+
+// Minimum, maximum and average over flash and RAM
+void hist_stats(hist_stats_t *s)
+{
+    unsigned int i;
+    long sum = 0;
+
+    s->count = 0;
+    for (i = 0; i < HIST_SEGS; i++)
+        if (hist_valid(i))
+            hist_walk(i, s, &sum);
+    for (i = 0; i < nsamples; i++)
+        hist_acc(s, &sum, samples[i]);
+    if (s->count)
+        s->avg = sum / (long) s->count;
+}
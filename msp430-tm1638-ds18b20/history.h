@@ -0,0 +1,39 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+#include <stdint.h>
+
+// ##################### Temperature history ######################
+// Samples (1/16 degC, DS18B20 format) are collected in RAM and written
+// to flash a batch at a time, so the flash is only erased and programmed
+// every HIST_BATCH samples. The flash is a ring of HIST_SEGS segments,
+// each erased in turn when the one before it is full: every segment
+// sees the same number of erase cycles and the oldest batches go first.
+//
+// Segment: HIST_MAGIC, sequence number (0..254, newest is highest
+// modulo 255), then batches:
+//  count (1..HIST_BATCH), first sample, count - 1 deltas
+// every value a zigzag varint: sign in bit 0, 7 bits per byte, low
+// first, bit 7 set on all but the last byte. A batch of slowly changing
+// temperatures costs about one byte per sample. The count byte is
+// programmed last, so a batch cut off by a reset is never read back.
+
+#define HIST_BATCH      16      // samples per flash write
+#define HIST_SEGS       3       // info D, C, B
+#define HIST_MAGIC      0xA5
+#define HIST_HEADER     2       // magic, sequence
+
+typedef struct
+{
+    int16_t min, max, avg;
+    unsigned int count;         // samples in RAM and flash, 0: others void
+} hist_stats_t;
+
+// Function definitions:
+
+void hist_init();
+void hist_add(int16_t temp);
+int hist_full();
+void hist_flush();
+void hist_stats(hist_stats_t *s);
+
+#endif /* HISTORY_H_ */
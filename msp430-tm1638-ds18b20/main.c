@@ -1,8 +1,13 @@
-#include "msp430g2553.h"
+#include "hal.h"
 #include "stdint.h"
 #include "onewire.h"
-#include "delay.h"
+#include "ds18b20.h"
 #include "TM1638.h"
+#include "bench.h"
+#include "trace.h"
+#include "clock.h"
+#include "sched.h"
+#include "history.h"
 
 // MSP430 Ports Define
 #define LED_RED BIT0                        //RED Led
@@ -12,139 +17,9 @@
 
 void timer_init()
 {
-    CCTL0 = CCIE;
-    CCR0 = 20000;
-    TACTL = TASSEL_1 + MC_1;
-}
-
-void tm1638_float(float data)
-{
-//    unsigned long int integer_part;
-//    integer_part = data*10000;
-    ShowDecNumber(data * 10000, 16, 1);
-}
-
-// ##################### One-Wire ###############################
-
-void ow_portsetup()
-{
-    OWPORTDIR |= OWPORTPIN;
-    OWPORTOUT |= OWPORTPIN;
-    OWPORTREN |= OWPORTPIN;
-}
-
-uint16_t ReadDS1820(void)
-{
-    unsigned int i;
-    uint16_t byte = 0;
-    for (i = 16; i > 0; i--)
-    {
-        byte >>= 1;
-        if (ow_read_bit())
-        {
-            byte |= 0x8000;
-        }
-    }
-    return byte;
-}
-
-float GetData(void)
-{
-    uint16_t temp;
-    ow_reset();
-    ow_write_byte(0xcc); // skip ROM command
-    ow_write_byte(0x44); // convert T command
-    OW_HI
-    DELAY_MS(750); // at least 750 ms for the default 12-bit resolution
-    ow_reset();
-    ow_write_byte(0xcc); // skip ROM command
-    ow_write_byte(0xbe); // read scratchpad command
-    temp = ReadDS1820();
-
-    if (temp < 0x8000)
-    {
-        return (temp * 0.0625);
-    }
-    else
-    {
-        temp = (~temp) + 1;
-        return (temp * 0.0625);
-    }
-}
-
-int ow_reset()
-{
-    OW_LO
-    DELAY_US(480);                              // 480us minimum
-    OW_RLS
-    DELAY_US(40);                               // slave waits 15-60us
-    if (OWPORTIN & OWPORTPIN)
-        return 1;   // line should be pulled down by slave
-    DELAY_US(300);                          // slave TX presence pulse 60-240us
-    if (!(OWPORTIN & OWPORTPIN))
-        return 2;   // line should be "released" by slave
-    return 0;
-}
-
-
-void ow_write_bit(int bit)
-{
-    OW_HI
-    if (bit)
-    {
-        OW_LO
-        DELAY_US(5);
-        OW_RLS
-        DELAY_US(56);
-    }
-    else
-    {
-        OW_LO
-        DELAY_US(60);
-        OW_RLS
-        DELAY_US(1);
-    }
-}
-
-
-int ow_read_bit()
-{
-    int bit = 0;
-//  DELAY_US(1); // recovery, min 1us
-    OW_LO
-    DELAY_US(5); // hold min 1us
-    OW_RLS
-    DELAY_US(10); // 15us window
-    if (OWPORTIN & OWPORTPIN)
-    {
-        bit = 1;
-    }
-    DELAY_US(46); // rest of the read slot
-    return bit;
-}
-
-
-void ow_write_byte(uint8_t byte)
-{
-    int i;
-    for (i = 0; i < 8; i++)
-    {
-        ow_write_bit(byte & 1);
-        byte >>= 1;
-    }
-}
-
-uint8_t ow_read_byte()
-{
-    unsigned int i;
-    uint8_t byte = 0;
-    for (i = 0; i < 8; i++)
-    {
-        byte >>= 1;
-        if (ow_read_bit())
-            byte |= 0x80;
-    }
-    return byte;
+    HAL_TICK_CCTL = CCIE;
+    HAL_TICK_TOP = 20000;
+    HAL_TICK_CTL = TASSEL_1 + MC_1;
 }
 
 // ################# Clock ######################
@@ -155,14 +30,38 @@ struct
 
 enum
 {
-    State_Normal, State_Temp, State_SetTime
+    State_Normal, State_Temp, State_SetTime, State_History
 } state;
 
+// History view: minimum, maximum or average, KEY2 steps through them
+static unsigned char hist_show;
+static unsigned char have_temp;             // a conversion has been read
+
+// Scheduler events
+#define EV_TICK     0x01                    // 1 Hz clock advanced
+#define EV_KEY      0x02                    // key scan due
+#define EV_REDRAW   0x04                    // display content changed
+
+// Scheduler ticks, one per key scan (~10 ms)
+#define TICKS(ms)   ((unsigned int) ((ms) * 32768L / (1000L * KEY_SCAN_TICKS)))
+#define DISPLAY_MIN TICKS(50)               // redraws at most every 50 ms
+#define HIST_PERIOD 300                     // seconds between history samples
+#define HIST_TICKS  ((unsigned int) (HIST_PERIOD * 32768L / KEY_SCAN_TICKS))
+#if HIST_PERIOD * 32768L / KEY_SCAN_TICKS > 0x7FFF
+#error "HIST_PERIOD: longer than one scheduler sleep"
+#endif
+
 void showTemp()
 {
-    float temperate = GetData();
+    unsigned int n = 0;
+
+    if (ds18b20_sensors() > 1)
+    {
+        n = (t.s >> 1) % ds18b20_sensors();  // next sensor every 2 s
+        ShowDig(1, n + 1, 0);
+    }
     ShowDig(0, 2, 1);
-    ShowSignedDecNumber(temperate * 100, 4);
+    ShowSignedDecNumber(ds18b20_centi(ds18b20_temp(n)), 4);
 }
 
 void showTime()
@@ -176,6 +75,20 @@ void showTime()
     ShowDig(7, t.s % 10, 0);
 }
 
+void showHistory()
+{
+    static const char *const label[] = { "Lo", "Hi", "Av" };
+    hist_stats_t s;
+
+    hist_stats(&s);
+    ShowString(label[hist_show], 0, 0);
+    if (!s.count)
+        ShowString("------", 0, 2);
+    else
+        ShowSignedDecNumber(ds18b20_centi(hist_show == 0 ? s.min
+                : hist_show == 1 ? s.max : s.avg), 4);
+}
+
 void showSetTime()
 {
     ShowDig(0, 3, 1);
@@ -196,90 +109,286 @@ void timer0_init()
     // ACLK and Timer1_A
 
     // Set the timer A to ACLK, Up mode
-    TACTL = TASSEL_1 | MC_1;
+    HAL_TICK_CTL = TASSEL_1 | MC_1;
     // Reset timer at 32768-1 frequency (0x8000 = 32768)
-    TACCR0 = (0x8000) - 1;
+    HAL_TICK_TOP = (0x8000) - 1;
     // Clear the timer and enable timer interrupt
-    TACCTL0 = CCIE;
+    HAL_TICK_CCTL = CCIE;
+
+}
+
+// Offset of compare value ccr from the stopped counter, one period wraps
+static unsigned int tick_offset(unsigned int ccr, unsigned int now)
+{
+    if (ccr > now)
+        return ccr - now;
+    return ccr + HAL_TICK_TOP + 1 - now;          // passed this period, next one
+}
 
+// Start the second over at TAR = 0. CCR1 (conversion wait) and CCR2 (key
+// scan, scheduler tick) count on the same TAR, move them along with it.
+void timer0_restart()
+{
+    unsigned int now;
+
+    HAL_INT_OFF();
+    HAL_TICK_CTL &= ~MC_3;                  // stop, TAR reads stable
+    now = HAL_TICK_R;
+    HAL_CONV_CCR = tick_offset(HAL_CONV_CCR, now);
+    HAL_KEY_CCR = tick_offset(HAL_KEY_CCR, now);
+    HAL_TICK_R = 0;
+    HAL_TICK_CTL |= MC_1;
+    HAL_INT_ON();
 }
 // ##############################################
 
-int main()
+// ################# Tasks ######################
+// Clock, keypad, sensor and display each wait for their own wake-up,
+// none of them holds up another for longer than its own pass.
+
+// Time itself is counted in Timer0_A0, the task only shows it
+static char task_clock(sched_task_t *tk)
 {
-    init_WDT();
-    BCSCTL1 = CALBC1_1MHZ;
-    DCOCTL = CALDCO_1MHZ;
+    SCHED_BEGIN(tk);
+    while (1)
+    {
+        SCHED_WAIT_EVENT(tk, EV_TICK);
+        sched_post(EV_REDRAW);
+    }
+    SCHED_END(tk);
+}
 
-    init_Ports();
-    init_SPI();
-    ow_portsetup();
-    init_Display();
-    //timer_init();
-    timer0_init();
+// Keypad, scanned and debounced here on the Timer0_A1 tick: the read
+// waits on the SPI, which no ISR may do
+static char task_keys(sched_task_t *tk)
+{
+    unsigned int keys;
 
-    SetupDisplay(1, 1);
+    SCHED_BEGIN(tk);
+    while (1)
+    {
+        SCHED_WAIT_EVENT(tk, EV_KEY);
+        if (!KeyScan())
+            continue;                       // no key event this scan
+        while ((keys = GetKeyEvent()) != 0)
+        {
+            if (!(keys & (KEY_PRESS | KEY_REPEAT)))
+                continue;
+            keys &= KEY_MASK;
+            switch (state)
+            {
+            case State_Normal:
+                if (keys == TM1638_KEY3)
+                {
+                    state = State_SetTime;
+                }
+                if (keys == TM1638_KEY2)
+                {
+                    state = State_Temp;
+                    DisplayClean();
+                }
+                if (keys == TM1638_KEY4)
+                {
+                    state = State_History;
+                    hist_show = 0;
+                    DisplayClean();
+                }
+                break;
+            case State_History:
+                if (keys == TM1638_KEY2)
+                    hist_show = (hist_show + 1) % 3;
+                if (keys == TM1638_KEY1)
+                {
+                    state = State_Normal;
+                    DisplayClean();
+                }
+                break;
+            case State_Temp:
+                if (keys == TM1638_KEY1)
+                {
+                    state = State_Normal;
+                    DisplayClean();
+                }
+                break;
+            case State_SetTime:
+                if (keys == TM1638_KEY8)
+                    t.s = 0;
+                if (keys == TM1638_KEY7)
+                    t.m = (t.m + 1) % 60;
+                if (keys == TM1638_KEY5)
+                    t.m = (t.m > 0) ? (t.m - 1) : 59;
+                if (keys == TM1638_KEY6)
+                    t.h = (t.h + 1) % 24;
+                if (keys == TM1638_KEY4)
+                    t.h = (t.h > 0) ? (t.h - 1) : 23;
+                if (keys == TM1638_KEY1)
+                {
+                    timer0_restart();
+                    state = State_Normal;
+                }
+                break;
+            }
+        }
+        sched_post(EV_REDRAW);
+    }
+    SCHED_END(tk);
+}
 
-    // ########### Clock ###########
+// New temperature, 1 once per conversion. Also starts the next one.
+static int sensor_fresh()
+{
+    int fresh;
 
-    t.h = t.m = t.s = 0;
+    HAL_INT_OFF();
+    fresh = ds18b20_poll();
+    HAL_INT_ON();
+    return fresh;
+}
 
-    _BIS_SR(GIE);
-    state = State_Normal;
+// DS18B20 pipeline, paced by its own conversion timer (Timer0_A CCR1)
+static char task_sensor(sched_task_t *tk)
+{
+    SCHED_BEGIN(tk);
+    while (1)
+    {
+        SCHED_WAIT_UNTIL(tk, sensor_fresh());
+        have_temp = 1;
+        if (state == State_Temp)
+            sched_post(EV_REDRAW);
+    }
+    SCHED_END(tk);
+}
 
-    int keys;
+// Redraw on demand, at most once per DISPLAY_MIN
+static char task_display(sched_task_t *tk)
+{
+    SCHED_BEGIN(tk);
     while (1)
     {
-        keys = GetKey();
+        SCHED_WAIT_EVENT(tk, EV_REDRAW);
         switch (state)
         {
         case State_Normal:
             showTime();
-            if (keys == TM1638_KEY3)
-            {
-                state = State_SetTime;
-            }
-            if (keys == TM1638_KEY2)
-            {
-                state = State_Temp;
-                DisplayClean();
-            }
             break;
         case State_Temp:
             showTemp();
-            if (keys == TM1638_KEY1)
-            {
-                state = State_Normal;
-                DisplayClean();
-            }
             break;
         case State_SetTime:
             showSetTime();
-            if (keys == TM1638_KEY8)
-                t.s = 0;
-            __delay_cycles(50000);
-            if (keys == TM1638_KEY7)
-                t.m = (t.m + 1) % 60;
-            if (keys == TM1638_KEY5)
-                t.m = (t.m > 0) ? (t.m - 1) : 59;
-            __delay_cycles(50000);
-            if (keys == TM1638_KEY6)
-                t.h = (t.h + 1) % 24;
-            if (keys == TM1638_KEY4)
-                t.h = (t.h > 0) ? (t.h - 1) : 23;
-            __delay_cycles(50000);
-            if (keys == TM1638_KEY1)
-            {
-                TAR = 0;
-                state = State_Normal;
-            }
             break;
+        case State_History:
+            showHistory();
+            break;
+        }
+        DisplayRefresh();                   // sends changed digits only
+        SCHED_SLEEP(tk, DISPLAY_MIN);
+    }
+    SCHED_END(tk);
+}
+
+// Flash the history batch while no transfer needs interrupts, 1 when done
+static int history_flush()
+{
+    int done = 0;
+
+    HAL_INT_OFF();
+    if (!ow_busy() && !SpiBusy())
+    {
+        hist_flush();
+        done = 1;
+    }
+    HAL_INT_ON();
+    return done;
+}
+
+// Temperature history: sensor 0 every HIST_PERIOD into RAM, a full batch
+// to flash
+static char task_history(sched_task_t *tk)
+{
+    SCHED_BEGIN(tk);
+    while (1)
+    {
+        SCHED_SLEEP(tk, HIST_TICKS);
+        if (have_temp)
+        {
+            hist_add(ds18b20_temp(0));
+            if (state == State_History)
+                sched_post(EV_REDRAW);
+        }
+        if (hist_full())
+        {
+            SCHED_WAIT_UNTIL(tk, history_flush());
         }
-//        __delay_cycles(1000000);
     }
+    SCHED_END(tk);
+}
+
+static const sched_def_t tasks[] = {
+    { task_clock, EV_TICK },
+    { task_keys, EV_KEY },
+    { task_sensor, 0 },
+    { task_display, EV_REDRAW },
+    { task_history, 0 }
+};
+#define TASKS       (sizeof tasks / sizeof tasks[0])
+
+static sched_task_t task_state[TASKS];
+
+// Nothing to run: slow MCLK and sleep. Timer1_A times the 1-Wire slots
+// from SMCLK, so a transfer needs LPM0; the clock and the key scan
+// tick run from ACLK in LPM3, the scan itself is a short burst.
+void sched_idle(void)
+{
+    CLOCK_IDLE();                           // ISRs run slow until the next burst
+    TRACE_EXIT(TRACE_MAIN);
+#if TRACE
+    HAL_SLEEP(LPM0_bits);                   // TRACE_CLOCK keeps running
+#else
+    HAL_SLEEP(ow_busy() || SpiBusy() ? LPM0_bits : LPM3_bits);
+#endif
+    TRACE_ENTER(TRACE_MAIN);
+    CLOCK_BURST();                          // woken: the next pass at full speed
+}
+// ##############################################
+
+int main()
+{
+    init_WDT();
+    CLOCK_INIT();
+#if BENCH_SIM
+    bench_sim();                            // mspdebug's simulator, bench.mk
+#endif
+
+    init_Ports();
+    init_SPI();
+    ow_portsetup();
+    init_Display();
+    //timer_init();
+    timer0_init();
+    init_KeyScan();
+
+    SetupDisplay(1, 1);
+
+    // ########### Clock ###########
+
+    t.h = t.m = t.s = 0;
+
+    HAL_INT_ON();
+    CLOCK_BURST();                          // start-up work, then per event
+#if BENCH
+    bench_run();                            // results in bench_results[]
+    t.h = t.m = t.s = 0;                    // its Timer0_A0 calls ran the clock
+#endif
+    state = State_Normal;
+    ds18b20_search();
+    ds18b20_adaptive(1);                    // fast updates while it changes
+    hist_init();
+
+    sched_post(EV_REDRAW);                  // first draw
+    TRACE_ENTER(TRACE_MAIN);
+    sched_run(tasks, task_state, TASKS);
     // #############################
-//    __bis_SR_register(CPUOFF + GIE);            // LPM0, TA0_ISR will force exit
-//    _BIS_SR(LPM0_bits + GIE);                 // Enter LPM0 w/ interrupt
 }
 
 /*
@@ -294,24 +403,60 @@ int main()
  }
  */
 
+// Timer0_A CCR1/CCR2 interrupt service routine
+HAL_ISR(HAL_TICK_CC_VECTOR, Timer0_A1)
+{
+    TRACE_ENTER(TRACE_TIMER0_A1);
+    switch (HAL_TICK_IV)
+    {
+    case TA0IV_TACCR1:                       // DS18B20 conversion done
+        ds18b20_timer();
+        HAL_WAKE();                         // main drops to LPM0 for the read
+        break;
+    case TA0IV_TACCR2:                       // Key scan tick
+        KeyScanTick();
+        sched_tick();                       // sleeps run out on the same wake
+        sched_post(EV_KEY);                 // task_keys reads the keys
+        HAL_WAKE();
+        break;
+    }
+    TRACE_EXIT(TRACE_TIMER0_A1);
+}
+
+// USCI receive interrupt service routine: last byte of a TM1638 transfer
+// shifted out; with OW_UART also the 1-Wire echo on USCI_A0
+HAL_ISR(HAL_SPI_RX_VECTOR, USCIAB0RX)
+{
+    if (HAL_SPI_RX_PENDING && SpiEnd())
+        HAL_WAKE();                         // queue drained, LPM3 will do
+#if OW_UART
+    if (HAL_OWU_RX_PENDING && ow_uart_rx())
+        HAL_WAKE();
+#endif
+}
+
 //// ################# Clock ######################
-#pragma vector= TIMER0_A0_VECTOR
-__interrupt void Timer0_A0(void)
+HAL_ISR(HAL_TICK_VECTOR, Timer0_A0)
 {
-    P1OUT ^= BIT1;
+    TRACE_ENTER(TRACE_TICK);
+    HAL_BEAT_OUT ^= HAL_BEAT_PIN;
     //TACCTL0 &= ~CCIFG;
-    if (state == State_SetTime)
-        return;
-    if (++t.s >= 60)
+    if (state != State_SetTime)
     {
-        t.s = 0;
-        if (++t.m >= 60)
+        if (++t.s >= 60)
         {
-            t.m = 0;
-            if (++t.h >= 24)
+            t.s = 0;
+            if (++t.m >= 60)
             {
-                t.h = 0;
+                t.m = 0;
+                if (++t.h >= 24)
+                {
+                    t.h = 0;
+                }
             }
         }
+        sched_post(EV_TICK);
+        HAL_WAKE();
     }
+    TRACE_EXIT(TRACE_TICK);
 }
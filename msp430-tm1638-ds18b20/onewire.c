@@ -0,0 +1,569 @@
+#include "hal.h"
+#include "stdint.h"
+#include "onewire.h"
+#include "delay.h"
+#include "trace.h"
+
+// ##################### One-Wire ###############################
+// Bit engine on Timer1_A (SMCLK, continuous mode). Every slot is started
+// by a CCR0 compare interrupt, so the CPU can sleep between slots. P2.3 is
+// TA1.0/CCI0B while a transfer runs: the long low phases (reset, write 0)
+// end in the compare ISR, which only releases the line, and the presence
+// pulse is latched into SCCI on a compare. The master never drives DQ
+// high, a late ISR only stretches a low phase that has the room for it
+// (write 0 may run 60-120us); every other ISR has to stay short for
+// that. Short slots (write 1, read) are done completely inside the ISR,
+// where no other interrupt can stretch them.
+// The Dallas CRC8 of the received bits is updated in the read slot after
+// the sample, while the slot runs out anyway.
+//
+// With OW_UART (hal.h) USCI_A0 makes the slots instead, one UART byte
+// per slot: TXD pulls DQ low through a diode and RXD reads the echo.
+// 0xF0 at 9600 baud is the reset, a presence pulse shows up in the high
+// bits of the echo. At 115200 baud 0x00 is a write 0 (78us low) and 0xFF
+// a write 1 or read slot (8.7us low), the slave turns the echo of a read
+// into something else than 0xFF for a 0. The line timing is all in the
+// USCI, the RX interrupt only starts the next slot.
+
+#if !OW_UART
+#define OW_TICKS_US     (CLOCK_SMCLK_FREQ / 1000000L)
+#define OW_TICKS(us)    ((unsigned int)((us) * OW_TICKS_US))  // SMCLK
+#define OW_LEAD         20      // ticks the ISR needs before a new compare, MCLK >= SMCLK
+
+// Slot timing, us:
+#define OW_T_RESET      480     // reset low
+#define OW_T_PRESENCE   70      // release -> presence sample
+#define OW_T_RESET_END  410     // presence sample -> end of reset
+#define OW_T_SLOT       70      // slot start -> next slot start
+#define OW_T_WRITE0     60      // write 0 low
+#define OW_T_REC        5       // recovery after write 0
+#if OW_T_RESET * OW_TICKS_US > 0xFFFF - OW_LEAD
+#error "CLOCK_MHZ: 1-Wire reset does not fit a Timer1_A compare"
+#endif
+
+// Line control while the pin belongs to TA1.0 (OUTMOD_0, OUT = 0)
+#define OWT_LO          { OWPORTDIR |= OWPORTPIN; }
+#define OWT_RLS         { OWPORTDIR &= ~OWPORTPIN; }
+
+// Engine phases:
+#define OW_PH_IDLE      0
+#define OW_PH_RESET     1       // next compare: pull low for reset
+#define OW_PH_RESET_RLS 2       // next compare: end of reset low, release
+#define OW_PH_PRESENCE  3       // next compare: SCCI holds presence sample
+#define OW_PH_RESET_END 4       // next compare: SCCI holds released line
+#define OW_PH_SLOT      5       // next compare: start of a bit slot
+#define OW_PH_WRITE0    6       // next compare: write 0 finished
+#else
+#define OW_SMCLK        CLOCK_SMCLK_FREQ
+#define OW_BR(baud)     (OW_SMCLK / (baud))     // UCBRx and UCBRSx, eighths
+#define OW_BRS(baud)    ((OW_SMCLK * 16 / (baud) - OW_BR(baud) * 16 + 1) / 2)
+#define OW_BAUD_RESET   9600
+#define OW_BAUD_SLOT    115200
+#if OW_BR(OW_BAUD_SLOT) < 3 || OW_BR(OW_BAUD_RESET) > 0xFFFF
+#error "CLOCK_MHZ: 1-Wire UART baud rates out of reach of UCBRx"
+#endif
+
+// Engine phases:
+#define OW_PH_IDLE      0
+#define OW_PH_RESET     1       // reset byte on the line
+#define OW_PH_SLOT      5       // slot byte on the line
+#endif
+
+static volatile uint8_t ow_phase = OW_PH_IDLE;
+static volatile int ow_status;
+static const uint8_t *ow_tx;
+static uint8_t *ow_rx;
+static unsigned int ow_txbits, ow_rxbits;
+static uint8_t ow_bit;                      // current bit in *ow_tx / *ow_rx
+static uint8_t ow_crcreg;                   // CRC8 of received bits
+static unsigned int ow_rxbyte;              // index of byte in *ow_rx
+static const uint8_t *ow_chk_mask, *ow_chk_value;
+static int ow_abort;                        // status after abort reset
+static ow_callback_t ow_done;
+#if OW_UART
+static uint8_t ow_reading;                  // slot on the line is a read
+#endif
+
+void ow_portsetup()
+{
+    OWPORTDIR |= OWPORTPIN;
+    OWPORTOUT |= OWPORTPIN;
+    OWPORTREN |= OWPORTPIN;
+    HAL_OW_TCTL = TASSEL_2 | MC_2 | TRACE_TAIE; // SMCLK, continuous mode
+#if OW_UART
+    HAL_OWU_CTL1 = UCSWRST | UCSSEL_2;      // 8N1 UART on SMCLK
+    HAL_OWU_SEL |= HAL_OWU_PINS;
+    HAL_OWU_SEL2 |= HAL_OWU_PINS;
+#endif
+}
+
+#if OW_UART
+static void ow_baud(unsigned int br, unsigned int brs)
+{
+    HAL_OWU_CTL1 |= UCSWRST;
+    HAL_OWU_BR0 = br & 0xFF;
+    HAL_OWU_BR1 = br >> 8;
+    HAL_OWU_MCTL = brs << 1;                // UCBRSx
+    HAL_OWU_CTL1 &= ~UCSWRST;
+    HAL_OWU_RXIE_ON;                        // cleared by UCSWRST
+}
+
+static void ow_uart_reset()
+{
+    ow_baud(OW_BR(OW_BAUD_RESET), OW_BRS(OW_BAUD_RESET));
+    ow_phase = OW_PH_RESET;
+    HAL_OWU_TXBUF = 0xF0;
+}
+#else
+static void ow_schedule(unsigned int at)
+{
+    if ((int16_t)(at - HAL_OW_TR) < OW_LEAD)    // late, don't miss the compare
+        at = HAL_OW_TR + OW_LEAD;
+    HAL_OW_CCR = at;
+}
+#endif
+
+static void ow_finish(int status)
+{
+#if OW_UART
+    HAL_OWU_RXIE_OFF;
+#else
+    HAL_OW_CCTL = 0;
+    OWPORTDIR &= ~OWPORTPIN;
+    OWPORTSEL &= ~OWPORTPIN;                // back to GPIO, released
+#endif
+    ow_chk_mask = 0;
+    ow_status = status;
+    ow_phase = OW_PH_IDLE;
+    if (ow_done)
+    { // Decoding the result is a burst, whatever the ISR ran at
+        unsigned char run = CLOCK_SAVE();
+
+        CLOCK_BURST();
+        ow_done(status);
+        CLOCK_RESTORE(run);
+    }
+}
+
+#if OW_UART
+// Next slot byte, or the end of the transfer
+static void ow_uart_slot()
+{
+    if (ow_txbits)
+    {
+        HAL_OWU_TXBUF = (*ow_tx & ow_bit) ? 0xFF : 0x00;
+        ow_reading = 0;
+        ow_bit <<= 1;
+        if (!ow_bit)
+        {
+            ow_bit = 1;
+            ow_tx++;
+        }
+        if (!--ow_txbits)
+            ow_bit = 1;
+    }
+    else if (ow_rxbits)
+    {
+        HAL_OWU_TXBUF = 0xFF;
+        ow_reading = 1;
+    }
+    else
+    {
+        ow_finish(OW_OK);
+    }
+}
+
+// One received bit into *ow_rx and the CRC, check each complete byte
+static void ow_uart_bit(int bit)
+{
+    if (ow_bit == 1)
+        *ow_rx = 0;
+    if (bit)
+    {
+        *ow_rx |= ow_bit;
+        ow_crcreg ^= 1;
+    }
+    if (ow_crcreg & 1)
+        ow_crcreg = (ow_crcreg >> 1) ^ 0x8C;
+    else
+        ow_crcreg >>= 1;
+    ow_rxbits--;
+    ow_bit <<= 1;
+    if (!ow_bit)
+    {
+        ow_bit = 1;
+        if (ow_chk_mask && (*ow_rx & ow_chk_mask[ow_rxbyte])
+                != ow_chk_value[ow_rxbyte])
+        {
+            ow_abort = OW_FRAMING;          // reset ends the slave's answer
+            ow_rxbits = 0;
+            ow_phase = OW_PH_RESET;
+        }
+        ow_rx++;
+        ow_rxbyte++;
+    }
+}
+#endif
+
+// Start a transfer in the background: optional reset, then txbits bits
+// from tx and rxbits bits into rx, LSB first. done (may be 0) is called
+// from the interrupt with the transfer status.
+int ow_transfer(int reset, const uint8_t *tx, unsigned int txbits,
+                uint8_t *rx, unsigned int rxbits, ow_callback_t done)
+{
+    if (ow_phase != OW_PH_IDLE)
+        return -1;
+
+    ow_tx = tx;
+    ow_txbits = txbits;
+    ow_rx = rx;
+    ow_rxbits = rxbits;
+    ow_bit = 1;
+    ow_crcreg = 0;
+    ow_rxbyte = 0;
+    ow_abort = OW_OK;
+    ow_done = done;
+    ow_phase = reset ? OW_PH_RESET : OW_PH_SLOT;
+
+    OWPORTOUT |= OWPORTPIN;                 // released line pulled up
+    OWPORTREN |= OWPORTPIN;
+    OWPORTDIR &= ~OWPORTPIN;
+#if OW_UART
+    if (reset)
+    {
+        ow_uart_reset();
+    }
+    else
+    {
+        ow_baud(OW_BR(OW_BAUD_SLOT), OW_BRS(OW_BAUD_SLOT));
+        ow_uart_slot();
+    }
+#else
+    OWPORTSEL |= OWPORTPIN;                 // TA1.0 / CCI0B
+    HAL_OW_CCTL = CCIS_1;
+    HAL_OW_CCR = HAL_OW_TR + OW_LEAD;
+    HAL_OW_CCTL = CCIS_1 | CCIE;
+#endif
+    return 0;
+}
+
+// Check each received byte of the next transfer: (rx[i] & mask[i]) must
+// equal value[i], else the read is cut short by a bus reset (OW_FRAMING)
+void ow_expect(const uint8_t *mask, const uint8_t *value)
+{
+    ow_chk_mask = mask;
+    ow_chk_value = value;
+}
+
+// CRC8 over all bits received by the last transfer, 0 if the check byte matched
+uint8_t ow_crc()
+{
+    return ow_crcreg;
+}
+
+// Dallas CRC8 (x^8 + x^5 + x^4 + 1) of a buffer
+uint8_t ow_crc8(const uint8_t *data, unsigned int len)
+{
+    uint8_t crc = 0, byte, i;
+
+    while (len--)
+    {
+        byte = *data++;
+        for (i = 0; i < 8; i++)
+        {
+            if ((crc ^ byte) & 1)
+                crc = (crc >> 1) ^ 0x8C;
+            else
+                crc >>= 1;
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
+
+int ow_busy()
+{
+    return ow_phase != OW_PH_IDLE;
+}
+
+// Sleep in LPM0 until the running transfer is finished
+static int ow_wait()
+{
+    HAL_INT_OFF();
+    while (ow_phase != OW_PH_IDLE)
+    {
+        HAL_SLEEP(LPM0_bits);
+        HAL_INT_OFF();
+    }
+    HAL_INT_ON();
+    return ow_status;
+}
+
+// Start a transfer once the engine is free and wait for it. A background
+// transfer (ds18b20.c) may hold the engine, ow_transfer() refuses then.
+static int ow_run(int reset, const uint8_t *tx, unsigned int txbits,
+                  uint8_t *rx, unsigned int rxbits)
+{
+    HAL_INT_OFF();
+    while (ow_transfer(reset, tx, txbits, rx, rxbits, 0))
+    {
+        HAL_SLEEP(LPM0_bits);
+        HAL_INT_OFF();
+    }
+    HAL_INT_ON();
+    return ow_wait();
+}
+
+int ow_reset()
+{
+    return ow_run(1, 0, 0, 0, 0);
+}
+
+void ow_write_bit(int bit)
+{
+    uint8_t byte = bit;
+    ow_run(0, &byte, 1, 0, 0);
+}
+
+int ow_read_bit()
+{
+    uint8_t byte = 1;                       // released line if it failed
+    ow_run(0, 0, 0, &byte, 1);
+    return byte;
+}
+
+void ow_write_byte(uint8_t byte)
+{
+    ow_run(0, &byte, 8, 0, 0);
+}
+
+uint8_t ow_read_byte()
+{
+    uint8_t byte = 0xFF;
+    ow_run(0, 0, 0, &byte, 8);
+    return byte;
+}
+
+// SEARCH_ROM enumeration, stores up to max ROM codes and returns the count
+int ow_search(uint8_t rom[][8], int max)
+{
+    uint8_t id[8];
+    uint8_t *byte, mask, id_bit, cmp_bit, dir;
+    int count = 0, bit, last_fork = 0, last_zero;
+
+    do
+    {
+        if (ow_reset())
+            break;
+        ow_write_byte(DS1820_SEARCHROM);
+        last_zero = 0;
+        byte = id;
+        mask = 1;
+        for (bit = 1; bit <= 64; bit++)
+        {
+            id_bit = ow_read_bit();
+            cmp_bit = ow_read_bit();
+            if (id_bit && cmp_bit)
+                return count;               // nobody answered
+            if (id_bit != cmp_bit)
+                dir = id_bit;               // all devices agree
+            else
+            {
+                if (bit < last_fork)
+                    dir = (*byte & mask) != 0;  // same branch as last pass
+                else
+                    dir = (bit == last_fork);   // take 1 at the last fork
+                if (!dir)
+                    last_zero = bit;
+            }
+            if (dir)
+                *byte |= mask;
+            else
+                *byte &= ~mask;
+            ow_write_bit(dir);
+            mask <<= 1;
+            if (!mask)
+            {
+                mask = 1;
+                byte++;
+            }
+        }
+        if (!ow_crc8(id, 8))                // skip ROMs read with errors
+        {
+            for (bit = 0; bit < 8; bit++)
+                rom[count][bit] = id[bit];
+            count++;
+        }
+        last_fork = last_zero;
+    } while (last_fork && count < max);
+    return count;
+}
+
+#if !OW_UART
+// Timer1_A CCR0 interrupt service routine
+// 1-Wire bit engine
+HAL_ISR(HAL_OW_VECTOR, Timer1_A0)
+{
+    unsigned int start;
+
+    TRACE_ENTER(TRACE_ONEWIRE);             // TRACE stretches every slot by
+    TRACE_DUE(TRACE_ONEWIRE, HAL_OW_CCR);   // ~60 cycles, 1-Wire allows that
+    switch (ow_phase)
+    {
+    case OW_PH_RESET:
+        OWT_LO
+        HAL_OW_CCR = HAL_OW_TR + OW_TICKS(OW_T_RESET);
+        ow_phase = OW_PH_RESET_RLS;
+        break;
+
+    case OW_PH_RESET_RLS:
+        OWT_RLS                             // slave waits 15-60us
+        HAL_OW_CCR = HAL_OW_TR + OW_TICKS(OW_T_PRESENCE);   // from the release
+        ow_phase = OW_PH_PRESENCE;
+        break;
+
+    case OW_PH_PRESENCE:
+        if (HAL_OW_CCTL & SCCI)
+        {
+            ow_finish(ow_abort ? ow_abort : OW_NO_PRESENCE);
+            break;
+        }
+        HAL_OW_CCR += OW_TICKS(OW_T_RESET_END);
+        ow_phase = OW_PH_RESET_END;
+        break;
+
+    case OW_PH_RESET_END:
+        if (!(HAL_OW_CCTL & SCCI))
+        {
+            ow_finish(ow_abort ? ow_abort : OW_BUS_LOW);
+            break;
+        }
+        if (ow_abort)
+        {
+            ow_finish(ow_abort);
+            break;
+        }
+        ow_phase = OW_PH_SLOT;
+        // no break: first slot starts right away
+
+    case OW_PH_SLOT:
+        start = HAL_OW_TR;                  // a late slot keeps its full length
+        if (ow_txbits)
+        {
+            if (*ow_tx & ow_bit)
+            {
+                OWT_LO
+                DELAY_US(1);
+                OWT_RLS
+            }
+            else
+            {
+                OWT_LO
+                HAL_OW_CCR = HAL_OW_TR + OW_TICKS(OW_T_WRITE0);
+                ow_phase = OW_PH_WRITE0;
+            }
+            ow_bit <<= 1;
+            if (!ow_bit)
+            {
+                ow_bit = 1;
+                ow_tx++;
+            }
+            if (!--ow_txbits)
+                ow_bit = 1;
+            if (ow_phase == OW_PH_WRITE0)
+                break;
+        }
+        else if (ow_rxbits)
+        {
+            if (ow_bit == 1)
+                *ow_rx = 0;
+            OWT_LO
+            DELAY_US(1);                    // hold min 1us
+            OWT_RLS
+            DELAY_US(6);                    // sample inside the 15us window
+            if (OWPORTIN & OWPORTPIN)
+            {
+                *ow_rx |= ow_bit;
+                ow_crcreg ^= 1;
+            }
+            if (ow_crcreg & 1)
+                ow_crcreg = (ow_crcreg >> 1) ^ 0x8C;
+            else
+                ow_crcreg >>= 1;
+            ow_rxbits--;
+            ow_bit <<= 1;
+            if (!ow_bit)
+            {
+                ow_bit = 1;
+                if (ow_chk_mask && (*ow_rx & ow_chk_mask[ow_rxbyte])
+                        != ow_chk_value[ow_rxbyte])
+                {
+                    ow_abort = OW_FRAMING;  // reset ends the slave's answer
+                    ow_rxbits = 0;
+                    ow_phase = OW_PH_RESET;
+                }
+                ow_rx++;
+                ow_rxbyte++;
+            }
+        }
+        else
+        {
+            ow_finish(OW_OK);
+            break;
+        }
+        ow_schedule(start + OW_TICKS(OW_T_SLOT));
+        break;
+
+    case OW_PH_WRITE0:
+        OWT_RLS
+        ow_phase = OW_PH_SLOT;
+        ow_schedule(HAL_OW_TR + OW_TICKS(OW_T_REC));    // from the release
+        break;
+    }
+
+    if (ow_phase == OW_PH_IDLE)
+        HAL_WAKE();                         // wake ow_wait() or main loop
+    TRACE_EXIT(TRACE_ONEWIRE);
+}
+#else
+// USCI_A0 receive, from the USCIAB0RX ISR in main.c (USCI_B0, the TM1638
+// SPI, shares the vector). 1-Wire slot engine: the echo of the last byte
+// is in. Returns 1 when the transfer is finished, to wake the CPU.
+int ow_uart_rx()
+{
+    uint8_t echo, status;
+
+    TRACE_ENTER(TRACE_ONEWIRE);
+    status = HAL_OWU_STAT;                  // before RXBUF, reading it clears UCFE
+    echo = HAL_OWU_RXBUF;
+    switch (ow_phase)
+    {
+    case OW_PH_RESET:
+        if (status & UCFE)                  // no stop bit, DQ held low
+            ow_finish(ow_abort ? ow_abort : OW_BUS_LOW);
+        else if (echo == 0xF0)
+            ow_finish(ow_abort ? ow_abort : OW_NO_PRESENCE);
+        else if (ow_abort)
+            ow_finish(ow_abort);
+        else
+        {
+            ow_baud(OW_BR(OW_BAUD_SLOT), OW_BRS(OW_BAUD_SLOT));
+            ow_phase = OW_PH_SLOT;
+            ow_uart_slot();
+        }
+        break;
+
+    case OW_PH_SLOT:
+        if (ow_reading)
+            ow_uart_bit(echo == 0xFF);
+        if (ow_phase == OW_PH_RESET)
+            ow_uart_reset();                // ow_expect() mismatch
+        else
+            ow_uart_slot();
+        break;
+    }
+
+    TRACE_EXIT(TRACE_ONEWIRE);
+    return ow_phase == OW_PH_IDLE;          // wake ow_wait() or main loop
+}
+#endif
@@ -1,13 +1,9 @@
 #ifndef ONEWIRE_H_
 #define ONEWIRE_H_
 #include <stdint.h>
+#include "hal.h"
 
-// Port and pins definition:
-#define OWPORTDIR P2DIR
-#define OWPORTOUT P2OUT
-#define OWPORTIN P2IN
-#define OWPORTREN P2REN
-#define OWPORTPIN BIT3
+// Port and pins: OWPORT* in hal.h
 #define OW_LO {	OWPORTDIR |= OWPORTPIN;	OWPORTREN &= ~OWPORTPIN; OWPORTOUT &= ~OWPORTPIN; }
 #define OW_HI {	OWPORTDIR |= OWPORTPIN;	OWPORTREN &= ~OWPORTPIN; OWPORTOUT |= OWPORTPIN; }
 #define OW_RLS { OWPORTDIR &= ~OWPORTPIN; OWPORTREN |= OWPORTPIN; OWPORTOUT |= OWPORTPIN; }
@@ -26,16 +22,35 @@
 #define DS1820_ALARMSEARCH 			0xEC
 #define DS1820_CONVERT_T            0x44
 
+// Transfer status:
+#define OW_OK           0   // transfer complete
+#define OW_NO_PRESENCE  1   // line should be pulled down by slave
+#define OW_BUS_LOW      2   // line should be "released" by slave
+#define OW_FRAMING      3   // received byte failed ow_expect(), bus reset
+
+// Transfer completion callback:
+typedef void (*ow_callback_t)(int status);
+
 // Function definitions:
 
+void ow_portsetup();
+int ow_transfer(int reset, const uint8_t *tx, unsigned int txbits,
+                uint8_t *rx, unsigned int rxbits, ow_callback_t done);
+void ow_expect(const uint8_t *mask, const uint8_t *value);
+int ow_busy();
+uint8_t ow_crc();
+uint8_t ow_crc8(const uint8_t *data, unsigned int len);
 int ow_reset();
 void ow_write_bit(int bit);
 int ow_read_bit();
 void ow_write_byte(uint8_t byte);
 uint8_t ow_read_byte();
+int ow_search(uint8_t rom[][8], int max);
+#if OW_UART
+int ow_uart_rx();
+#endif
 void onewire_line_low();
 void onewire_line_high();
 void onewire_line_release();
-float GetData(void);
 
 #endif /* ONEWIRE_H_ */
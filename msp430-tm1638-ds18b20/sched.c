@@ -0,0 +1,90 @@
+#include "hal.h"
+#include "sched.h"
+
+volatile unsigned int sched_now;            // ticks, sched_tick()
+static volatile unsigned char sched_events; // posted since the last pass
+static volatile unsigned int sched_next;    // earliest wake while idle
+static volatile unsigned char sched_timed;  // sched_next is valid
+
+// Post events, from tasks and ISRs. An ISR still has to wake the CPU.
+void sched_post(unsigned char ev)
+{
+    unsigned short state = HAL_INT_STATE();
+
+    HAL_INT_OFF();
+    sched_events |= ev;
+    HAL_INT_RESTORE(state);
+}
+
+// Periodic ISR, returns 1 when a sleeping task is due and the CPU
+// has to be woken
+int sched_tick(void)
+{
+    sched_now++;
+    return sched_timed && (int) (sched_now - sched_next) >= 0;
+}
+
+// Take an event posted to t, 1 if it was there
+int sched_take(sched_task_t *t, unsigned char ev)
+{
+    if (!(t->ev & ev))
+        return 0;
+    t->ev &= ~ev;
+    return 1;
+}
+
+void sched_sleep(sched_task_t *t, unsigned int ticks)
+{
+    t->wake = sched_now + ticks;
+    t->flags |= SCHED_TIMED;
+}
+
+// Sleep of t run out, 1 once
+int sched_due(sched_task_t *t)
+{
+    if ((int) (sched_now - t->wake) < 0)
+        return 0;
+    t->flags &= ~SCHED_TIMED;
+    return 1;
+}
+
+// Run the tasks for ever
+void sched_run(const sched_def_t *def, sched_task_t *task, unsigned int n)
+{
+    unsigned int i, next = 0;
+    unsigned char posted, timed;
+
+    while (1)
+    {
+        HAL_INT_OFF();
+        posted = sched_events;
+        sched_events = 0;
+        HAL_INT_ON();
+        for (i = 0; i < n; i++)
+            task[i].ev |= posted & def[i].listen;
+        for (i = 0; i < n; i++)
+            def[i].fn(&task[i]);
+
+        // Earliest sleep to run out
+        timed = 0;
+        for (i = 0; i < n; i++)
+        {
+            if (!(task[i].flags & SCHED_TIMED))
+                continue;
+            if (!timed || (int) (task[i].wake - next) < 0)
+                next = task[i].wake;
+            timed = 1;
+        }
+
+        HAL_INT_OFF();
+        if (sched_events || (timed && (int) (sched_now - next) >= 0))
+        {
+            HAL_INT_ON();
+            continue;
+        }
+        sched_next = next;
+        sched_timed = timed;
+        sched_idle();
+        sched_timed = 0;
+    }
+}
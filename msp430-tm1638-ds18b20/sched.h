@@ -0,0 +1,68 @@
+#ifndef SCHED_H_
+#define SCHED_H_
+
+// ##################### Scheduler ################################
+// Cooperative tasks in protothread style. A task is a function that
+// returns at every wait and on the next call jumps back to where it
+// left off; the place is kept as a source line number in its
+// sched_task_t. Tasks share the one stack, so a task costs
+// sizeof(sched_task_t) bytes of RAM, but locals do not survive a wait
+// (keep them in statics) and no wait may sit inside a switch of the
+// task body.
+// A task waits for
+//  - events, bits posted by ISRs or other tasks with sched_post()
+//  - time, SCHED_SLEEP for a number of sched_tick() calls
+//  - any condition, SCHED_WAIT_UNTIL, checked again on every pass.
+// Every pass runs all tasks in table order, an event posted during a
+// pass gives another one. When a pass ends with nothing posted and no
+// sleep run out, sched_run() calls the application's sched_idle() to
+// sleep; an ISR that posts, or sched_tick() when a sleep runs out,
+// wakes the CPU. Conditions are only checked on passes, so whatever
+// makes one true must wake the CPU or post.
+
+#define SCHED_WAITING   0
+#define SCHED_DONE      1       // task returned, starts over next pass
+
+#define SCHED_TIMED     0x01    // sched_task_t flags: sleeping until wake
+
+typedef struct
+{
+    unsigned int lc;            // continuation, 0 = start
+    unsigned int wake;          // sched_now the sleep runs out
+    unsigned char ev;           // events posted, not yet taken
+    unsigned char flags;
+} sched_task_t;
+
+typedef char (*sched_fn_t)(sched_task_t *t);
+
+typedef struct
+{
+    sched_fn_t fn;
+    unsigned char listen;       // events delivered to this task
+} sched_def_t;
+
+// Task body
+#define SCHED_BEGIN(t)          switch ((t)->lc) { case 0:
+#define SCHED_END(t)            } (t)->lc = 0; return SCHED_DONE;
+#define SCHED_WAIT_UNTIL(t, c)  do { (t)->lc = __LINE__; case __LINE__: \
+                                     if (!(c)) return SCHED_WAITING; } while (0)
+#define SCHED_WAIT_EVENT(t, e)  SCHED_WAIT_UNTIL(t, sched_take(t, e))
+#define SCHED_SLEEP(t, ticks)   do { sched_sleep(t, ticks); \
+                                     SCHED_WAIT_UNTIL(t, sched_due(t)); } while (0)
+
+extern volatile unsigned int sched_now;
+
+// Function definitions:
+
+void sched_run(const sched_def_t *def, sched_task_t *task, unsigned int n);
+void sched_post(unsigned char ev);
+int sched_tick(void);
+int sched_take(sched_task_t *t, unsigned char ev);
+void sched_sleep(sched_task_t *t, unsigned int ticks);
+int sched_due(sched_task_t *t);
+
+// Supplied by the application, called with interrupts off; sleep in
+// an LPM with GIE set, return after the wake-up
+void sched_idle(void);
+
+#endif /* SCHED_H_ */
@@ -0,0 +1,51 @@
+#include "trace.h"
+
+#if TRACE
+
+trace_t trace_ring = { TRACE_MAGIC, TRACE_LEN, 0, TRACE_FREQ, { { 0, 0 } } };
+volatile unsigned int trace_wraps;          // TRACE_CLOCK overflows
+
+// Record with interrupts off. A wrap not counted yet shows as the
+// overflow flag still set and a small count.
+static void put(unsigned int ev, unsigned int t)
+{
+    unsigned int i, w;
+
+    w = trace_wraps;
+    if (TRACE_WRAPPED && t < 0x8000)
+        w++;
+    i = trace_ring.head;
+    trace_ring.rec[i].ev = ev | ((w & TRACE_WRAP_MASK) << TRACE_WRAP_SHIFT);
+    trace_ring.rec[i].t = t;
+    trace_ring.head = (i + 1) & (TRACE_LEN - 1);
+}
+
+// Append a record with timestamp t, overwriting the oldest. Safe from
+// tasks and ISRs.
+void trace_put(unsigned int ev, unsigned int t)
+{
+    unsigned short state = HAL_INT_STATE();
+
+    HAL_INT_OFF();
+    put(ev, t);
+    HAL_INT_RESTORE(state);
+}
+
+// Append a record stamped now; clock and wrap count are read together
+void trace_now(unsigned int ev)
+{
+    unsigned short state = HAL_INT_STATE();
+
+    HAL_INT_OFF();
+    put(ev, TRACE_CLOCK);
+    HAL_INT_RESTORE(state);
+}
+
+// Timer1_A overflow, TAIE set by ow_portsetup() when tracing
+HAL_ISR(HAL_OW_WRAP_VECTOR, trace_wrap)
+{
+    if (HAL_OW_IV == TA1IV_TAIFG)
+        trace_wraps++;
+}
+
+#endif
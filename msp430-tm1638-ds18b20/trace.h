@@ -0,0 +1,82 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+// ##################### Trace ring ###############################
+// Build with --define=TRACE=1 to record ISR and task entry/exit in
+// trace_ring, each record an event word and a TRACE_CLOCK timestamp.
+// With TRACE 0 the macros are empty and trace.c compiles to nothing.
+// Save trace_ring from the debugger (raw binary or TI data format) and
+// run tools/tracedump on it for duration, period, jitter and latency.
+// TRACE_CLOCK is Timer1_A on SMCLK, CLOCK_SMCLK_FREQ ticks that wrap
+// after 32ms at 2MHz; while tracing the main loop idles in LPM0 so it
+// keeps counting. Its overflow interrupt counts the wraps into the
+// records, intervals up to 2^25 ticks (16s at 2MHz) come out exact.
+
+#include "hal.h"
+#include "clock.h"
+
+#ifndef TRACE
+#define TRACE 0
+#endif
+
+#ifndef TRACE_LEN
+#define TRACE_LEN       32                  // records, power of two
+#endif
+#define TRACE_MAGIC     0x7ACF              // 0x7ACE: records without wrap count
+#define TRACE_CLOCK     HAL_OW_TR
+#define TRACE_WRAPPED   (HAL_OW_TCTL & TAIFG) // overflow not counted yet
+#define TRACE_FREQ      CLOCK_SMCLK_FREQ    // TRACE_CLOCK ticks per second
+
+// Event word: kind in bits 15..13, TRACE_CLOCK wraps (mod 512) in 12..4,
+// source in 3..0. The wrap count makes timestamps 25 bits wide.
+#define TRACE_EV_ENTER  0x0000
+#define TRACE_EV_EXIT   0x2000
+#define TRACE_EV_DUE    0x4000              // inside ENTER/EXIT: when the source was due
+#define TRACE_EV_MARK   0x6000              // timestamps restart here
+#define TRACE_EV_HOLD   0x8000              // timestamps void until the next MARK
+#define TRACE_WRAP_SHIFT 4
+#define TRACE_WRAP_MASK 0x01FF
+
+// Sources
+#define TRACE_TICK      1                   // Timer0_A0, 1 Hz clock
+#define TRACE_TIMER0_A1 2                   // Timer0_A1, DS18B20 wait and key scan
+#define TRACE_ONEWIRE   3                   // Timer1_A0, 1-Wire bit engine
+#define TRACE_MAIN      4                   // main loop, keys and redraw
+
+// Layout read by tracedump, 16-bit little endian words
+typedef struct
+{
+    unsigned int magic;                     // TRACE_MAGIC
+    unsigned int len;                       // TRACE_LEN
+    unsigned int head;                      // next record written
+    unsigned long freq;                     // TRACE_FREQ
+    struct
+    {
+        unsigned int ev, t;
+    } rec[TRACE_LEN];
+} trace_t;
+
+#if TRACE
+extern trace_t trace_ring;
+
+extern volatile unsigned int trace_wraps;
+
+void trace_put(unsigned int ev, unsigned int t);
+void trace_now(unsigned int ev);
+
+#define TRACE_ENTER(src)    trace_now(TRACE_EV_ENTER | (src))
+#define TRACE_EXIT(src)     trace_now(TRACE_EV_EXIT | (src))
+#define TRACE_DUE(src, t)   trace_put(TRACE_EV_DUE | (src), (t))
+#define TRACE_MARK(src)     trace_now(TRACE_EV_MARK | (src))
+#define TRACE_HOLD(src)     trace_put(TRACE_EV_HOLD | (src), 0)
+#define TRACE_TAIE          TAIE            // count TRACE_CLOCK wraps
+#else
+#define TRACE_ENTER(src)
+#define TRACE_EXIT(src)
+#define TRACE_DUE(src, t)
+#define TRACE_MARK(src)
+#define TRACE_HOLD(src)
+#define TRACE_TAIE          0
+#endif
+
+#endif /* TRACE_H_ */
@@ -9,21 +9,39 @@ CMD_SRCS += \
 ../lnk_msp430g2452.cmd 
 
 C_SRCS += \
-../main.c 
+../cir.c \
+../irdec.c \
+../main.c \
+../trace.c 
 
 C_DEPS += \
-./main.d 
+./cir.d \
+./irdec.d \
+./main.d \
+./trace.d 
 
 OBJS += \
-./main.obj 
+./cir.obj \
+./irdec.obj \
+./main.obj \
+./trace.obj 
 
 OBJS__QUOTED += \
-"main.obj" 
+"cir.obj" \
+"irdec.obj" \
+"main.obj" \
+"trace.obj" 
 
 C_DEPS__QUOTED += \
-"main.d" 
+"cir.d" \
+"irdec.d" \
+"main.d" \
+"trace.d" 
 
 C_SRCS__QUOTED += \
-"../main.c" 
+"../cir.c" \
+"../irdec.c" \
+"../main.c" \
+"../trace.c" 
 
 
@@ -0,0 +1,290 @@
+#include "cir.h"
+
+// ##################### Protocols ###############################
+
+const cir_proto_t cir_protos[CIR_PROTOS] = {
+    // NEC: 38kHz, 9ms + 4.5ms leader, 562us marks, space 562us (0) or
+    // 1687us (1), stop mark. 32 bits LSB first: address, ~address,
+    // command, ~command
+    { CIR_DISTANCE, 32, 0, CIR_CCR0(38000),
+      CIR_SYM(9000), CIR_SYM(4500),
+      CIR_SYM(562), CIR_SYM(562), CIR_SYM(562), CIR_SYM(1687) },
+    // Philips RC-5: 36kHz, 889us half bits, 14 bits MSB first:
+    // S1 S2 toggle, 5 address, 6 command
+    { CIR_BIPHASE, 14, 1, CIR_CCR0(36000),
+      { 0, 0, 0 }, { 0, 0, 0 },
+      CIR_SYM(889), CIR_SYM(889), CIR_SYM(1778), CIR_SYM(1778) },
+    // Sony SIRC: 40kHz, 2.4ms + 600us leader, mark 600us (0) or
+    // 1200us (1), 600us spaces. 12 bits LSB first: 7 command, 5 address
+    { CIR_WIDTH, 12, 0, CIR_CCR0(40000),
+      CIR_SYM(2400), CIR_SYM(600),
+      CIR_SYM(600), CIR_SYM(600), CIR_SYM(1200), CIR_SYM(600) }
+};
+
+#define CIR_IN(d, s)    ((d) >= (s).lo && (d) <= (s).hi)
+
+// ##################### Receiver ################################
+
+// Decoder states
+#define CIR_IDLE        0       // waiting for a leader (biphase: a quiet line)
+#define CIR_LEAD        1       // leader mark seen
+#define CIR_MARK        2       // next is the mark of a bit (biphase: last edge mid bit)
+#define CIR_SPACE       3       // next is the space of a bit (biphase: last edge on a bit boundary)
+
+typedef struct
+{
+    unsigned char state;
+    unsigned char count;        // bits received
+    unsigned char cand;         // bit values the mark allows, 1 = 0, 2 = 1
+    unsigned long code;
+    unsigned long mask;         // next bit, LSB first codes
+} cir_rx_t;
+
+// Capture interrupt only
+static cir_rx_t cir_rx[CIR_PROTOS];
+static uint16_t cir_last;       // ACLK time of the previous edge
+
+// Forget all frames in progress, the next edge only sets the time base
+void cir_reset(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < CIR_PROTOS; i++)
+        cir_rx[i].state = CIR_IDLE;
+    cir_last = 0;
+}
+
+static void cir_begin(cir_rx_t *rx)
+{
+    rx->count = 0;
+    rx->code = 0;
+    rx->mask = 1;
+}
+
+// One bit received. Shifts by one place only, so the time per bit
+// does not depend on its position.
+static void cir_bit(unsigned int proto, cir_rx_t *rx, unsigned int bit)
+{
+    const cir_proto_t *p = &cir_protos[proto];
+
+    if (p->msb_first)
+    {
+        rx->code = (rx->code << 1) | bit;
+    }
+    else
+    {
+        if (bit)
+            rx->code |= rx->mask;
+        rx->mask <<= 1;
+    }
+    if (++rx->count == p->bits)
+    {
+        rx->state = CIR_IDLE;
+        cir_received(proto, rx->code);
+    }
+}
+
+// Pulse distance and pulse width codes. The mark narrows the bit down to
+// the symbols it fits, the space picks one of them.
+static void cir_pulse(unsigned int proto, uint16_t d, unsigned int mark)
+{
+    const cir_proto_t *p = &cir_protos[proto];
+    cir_rx_t *rx = &cir_rx[proto];
+    unsigned int cand;
+
+    switch (rx->state)
+    {
+    case CIR_LEAD:
+        if (!mark && CIR_IN(d, p->lead_off))
+        {
+            cir_begin(rx);
+            rx->state = CIR_MARK;
+            return;
+        }
+        break;
+    case CIR_MARK:
+        if (mark)
+        {
+            cand = CIR_IN(d, p->on0) | (CIR_IN(d, p->on1) << 1);
+            if (cand == 0)
+                break;
+            if (cand != 3 && rx->count == p->bits - 1)
+            { // Last bit known from its mark, its space runs into the gap
+                cir_bit(proto, rx, cand == 2);
+                return;
+            }
+            rx->cand = cand;
+            rx->state = CIR_SPACE;
+            return;
+        }
+        break;
+    case CIR_SPACE:
+        if (!mark)
+        {
+            cand = rx->cand & (CIR_IN(d, p->off0) | (CIR_IN(d, p->off1) << 1));
+            if (cand == 1 || cand == 2)
+            {
+                rx->state = CIR_MARK;
+                cir_bit(proto, rx, cand == 2);
+                return;
+            }
+        }
+        break;
+    }
+    // Not part of a frame, but it may be a new leader
+    rx->state = (mark && CIR_IN(d, p->lead_on)) ? CIR_LEAD : CIR_IDLE;
+}
+
+// Biphase codes. Every bit has an edge in the middle, space to mark is
+// a 1. A long run can only end in the middle of a bit.
+static void cir_biphase(unsigned int proto, uint16_t d, unsigned int mark)
+{
+    const cir_proto_t *p = &cir_protos[proto];
+    cir_rx_t *rx = &cir_rx[proto];
+    unsigned int half, full;
+
+    half = mark ? CIR_IN(d, p->on0) : CIR_IN(d, p->off0);
+    full = mark ? CIR_IN(d, p->on1) : CIR_IN(d, p->off1);
+    switch (rx->state)
+    {
+    case CIR_MARK:
+        if (half)
+        {
+            rx->state = CIR_SPACE;
+            return;
+        }
+        if (full)
+        {
+            cir_bit(proto, rx, !mark);
+            return;
+        }
+        break;
+    case CIR_SPACE:
+        if (half)
+        {
+            rx->state = CIR_MARK;
+            cir_bit(proto, rx, !mark);
+            return;
+        }
+        break;
+    }
+    // A mark after a quiet line is the middle of the first bit, always 1
+    if (!mark && d > p->off1.hi)
+    {
+        cir_begin(rx);
+        rx->state = CIR_MARK;
+        cir_bit(proto, rx, 1);
+    }
+    else
+    {
+        rx->state = CIR_IDLE;
+    }
+}
+
+// One receiver edge at ACLK time t, level is the receiver output after
+// it (0 = carrier). Every protocol advances by one step.
+void cir_edge(uint16_t t, unsigned int level)
+{
+    unsigned int i;
+    uint16_t d = t - cir_last;
+
+    cir_last = t;
+    for (i = 0; i < CIR_PROTOS; i++)
+    {
+        if (cir_protos[i].coding == CIR_BIPHASE)
+            cir_biphase(i, d, level);
+        else
+            cir_pulse(i, d, level);
+    }
+}
+
+// ##################### Sender ##################################
+
+// Sender phases
+#define CIR_TX_LEAD_ON  0
+#define CIR_TX_LEAD_OFF 1
+#define CIR_TX_MARK     2       // biphase: first half of a bit
+#define CIR_TX_SPACE    3       // biphase: second half of a bit
+#define CIR_TX_END      4
+
+// cir_start() and cir_symbol() only, one caller at a time
+static const cir_proto_t *tx_proto;
+static unsigned long tx_code, tx_mask;
+static unsigned char tx_phase, tx_count, tx_run, tx_carrier, tx_bit;
+
+// Start sending a frame, cir_symbol() then gives it a run at a time
+void cir_start(unsigned int proto, unsigned long code)
+{
+    tx_proto = &cir_protos[proto];
+    tx_code = code;
+    tx_mask = tx_proto->msb_first ? 1UL << (tx_proto->bits - 1) : 1;
+    tx_count = 0;
+    tx_phase = (tx_proto->coding == CIR_BIPHASE) ? CIR_TX_MARK : CIR_TX_LEAD_ON;
+}
+
+// Next mark or space: carrier on (1) or off (0) for *run watchdog
+// intervals, -1 when the frame is over
+int cir_symbol(unsigned char *run)
+{
+    const cir_proto_t *p = tx_proto;
+
+    switch (tx_phase)
+    {
+    case CIR_TX_LEAD_ON:
+        tx_carrier = 1;
+        tx_run = p->lead_on.tx;
+        tx_phase = CIR_TX_LEAD_OFF;
+        break;
+    case CIR_TX_LEAD_OFF:
+        tx_carrier = 0;
+        tx_run = p->lead_off.tx;
+        tx_phase = CIR_TX_MARK;
+        break;
+    case CIR_TX_MARK:
+        if (tx_count == p->bits)
+        {
+            if (p->coding != CIR_DISTANCE)
+                return -1;
+            // Stop mark, ends the last space
+            tx_carrier = 1;
+            tx_run = p->on0.tx;
+            tx_phase = CIR_TX_END;
+            break;
+        }
+        tx_bit = (tx_code & tx_mask) != 0;
+        if (p->coding == CIR_BIPHASE)
+        {
+            tx_carrier = !tx_bit;
+            tx_run = p->on0.tx;
+        }
+        else
+        {
+            tx_carrier = 1;
+            tx_run = tx_bit ? p->on1.tx : p->on0.tx;
+        }
+        tx_phase = CIR_TX_SPACE;
+        break;
+    case CIR_TX_SPACE:
+        if (p->coding == CIR_BIPHASE)
+        {
+            tx_carrier = tx_bit;
+            tx_run = p->off0.tx;
+        }
+        else
+        {
+            tx_carrier = 0;
+            tx_run = tx_bit ? p->off1.tx : p->off0.tx;
+        }
+        if (p->msb_first)
+            tx_mask >>= 1;
+        else
+            tx_mask <<= 1;
+        tx_count++;
+        tx_phase = CIR_TX_MARK;
+        break;
+    default:
+        return -1;
+    }
+    *run = tx_run;
+    return tx_carrier;
+}
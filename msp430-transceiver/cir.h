@@ -0,0 +1,82 @@
+#ifndef CIR_H_
+#define CIR_H_
+
+// Consumer IR remote control protocols, one table entry each.
+// Receiving is done per edge from the capture interrupt, every protocol
+// in the table is tried in parallel with a fixed amount of work per edge.
+// Sending produces one mark or space per call, its length counted in
+// watchdog intervals of SMCLK / CIR_WDT_DIV, 64us at 1MHz and 8MHz.
+
+#include <stdint.h>
+#include "clock.h"
+
+#define CIR_ACLK_FREQ   CLOCK_ACLK_FREQ
+#define CIR_SMCLK_FREQ  CLOCK_SMCLK_FREQ
+#if CIR_SMCLK_FREQ > 1000000L
+#define CIR_WDT_DIV     512     // WDT_MDLY_0_5
+#else
+#define CIR_WDT_DIV     64      // WDT_MDLY_0_064
+#endif
+#define CIR_TX_MAX      9000    // longest symbol, NEC leader, us
+
+// Microseconds to ACLK ticks, to watchdog intervals
+#define CIR_TICKS(us)   ((uint16_t) ((us) * CIR_ACLK_FREQ / 1000000L))
+#define CIR_TX(us)      ((unsigned char) (((us) * (CIR_SMCLK_FREQ / 1000L) + CIR_WDT_DIV * 500L) / (CIR_WDT_DIV * 1000L)))
+// Timer_A CCR0 for the carrier, TA0.0 toggles on every match
+#define CIR_CCR0(hz)    ((unsigned char) ((CIR_SMCLK_FREQ + (hz)) / (2 * (hz)) - 1))
+
+#if CIR_TX_MAX * (CIR_SMCLK_FREQ / 1000L) / (CIR_WDT_DIV * 1000L) > 255
+#error "CLOCK_SMCLK_DIV: consumer IR symbols overflow the watchdog interval count"
+#endif
+#if CIR_WDT_DIV * 10000L > CIR_SMCLK_FREQ
+#error "CLOCK_SMCLK_DIV: watchdog interval over 100us, too coarse for consumer IR"
+#endif
+#if (CIR_SMCLK_FREQ + 36000L) / 72000L > 256
+#error "CLOCK_SMCLK_DIV: consumer IR carrier CCR0 over 255"
+#endif
+
+// A mark or space: length to send and window accepted on receive, +-25%
+#define CIR_SYM(us)     { CIR_TX(us), CIR_TICKS((us) * 3L / 4), CIR_TICKS((us) * 5L / 4) }
+
+// Line codes
+#define CIR_DISTANCE    0       // bit in the space length (NEC)
+#define CIR_WIDTH       1       // bit in the mark length (SIRC)
+#define CIR_BIPHASE     2       // Manchester, 1 = space/mark (RC-5)
+
+// Protocols, index into cir_protos[]
+#define CIR_NEC         0
+#define CIR_RC5         1
+#define CIR_SIRC        2
+#define CIR_PROTOS      3
+
+typedef struct
+{
+    unsigned char tx;           // watchdog intervals, CIR_TX()
+    uint16_t lo, hi;            // ACLK ticks
+} cir_sym_t;
+
+// Pulse codes: lead_on lead_off, then on0 off0 (0) or on1 off1 (1) per
+// bit, a final on0 mark after the last bit for CIR_DISTANCE.
+// CIR_BIPHASE: on0/off0 is a half bit, on1/off1 two halves, no leader.
+typedef struct
+{
+    unsigned char coding;       // CIR_DISTANCE, CIR_WIDTH, CIR_BIPHASE
+    unsigned char bits;         // bits per frame, up to 32
+    unsigned char msb_first;
+    unsigned char carrier;      // CIR_CCR0()
+    cir_sym_t lead_on, lead_off, on0, off0, on1, off1;
+} cir_proto_t;
+
+extern const cir_proto_t cir_protos[CIR_PROTOS];
+
+// Function definitions:
+
+void cir_reset(void);
+void cir_edge(uint16_t t, unsigned int level);
+void cir_start(unsigned int proto, unsigned long code);
+int cir_symbol(unsigned char *run);
+
+// Supplied by the application, called from cir_edge() for each frame
+void cir_received(unsigned int proto, unsigned long code);
+
+#endif /* CIR_H_ */
@@ -0,0 +1,61 @@
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+// ##################### Clock profile ###############################
+// The one place the clocks are set. Build with --define=CLOCK_MHZ=16 and
+// the carrier, the slot clock and the beat divider follow from it;
+// combinations that cannot be met stop the build. MCLK = DCO,
+// SMCLK = DCO / CLOCK_SMCLK_DIV, ACLK 32768Hz for the beat and capture.
+// The G2452 only has a 1MHz DCO calibration in info flash: for any other
+// rate pass CLOCK_CALBC1 and CLOCK_CALDCO measured on the part.
+// Nothing in here touches the hardware before CLOCK_INIT(), so the
+// portable decoder can use the derived constants too.
+
+#ifndef CLOCK_MHZ
+#define CLOCK_MHZ       1
+#endif
+
+#if CLOCK_MHZ == 1
+#define CLOCK_CALBC1    CALBC1_1MHZ
+#define CLOCK_CALDCO    CALDCO_1MHZ
+#elif !defined(CLOCK_CALBC1) || !defined(CLOCK_CALDCO)
+#error "CLOCK_MHZ: G2452 is calibrated for 1MHz only, define CLOCK_CALBC1 and CLOCK_CALDCO"
+#elif CLOCK_MHZ > 16
+#error "CLOCK_MHZ: 16MHz at most"
+#endif
+
+// SMCLK runs the carrier and the watchdog slot clock. Consumer IR
+// leaders must fit 255 slot intervals of SMCLK / 512, so above 12MHz
+// it is halved.
+#ifndef CLOCK_SMCLK_DIV
+#if CLOCK_MHZ > 12
+#define CLOCK_SMCLK_DIV 2
+#else
+#define CLOCK_SMCLK_DIV 1
+#endif
+#endif
+
+#if CLOCK_SMCLK_DIV == 1
+#define CLOCK_DIVS      0x00    // DIVS_0
+#elif CLOCK_SMCLK_DIV == 2
+#define CLOCK_DIVS      0x02    // DIVS_1
+#elif CLOCK_SMCLK_DIV == 4
+#define CLOCK_DIVS      0x04    // DIVS_2
+#elif CLOCK_SMCLK_DIV == 8
+#define CLOCK_DIVS      0x06    // DIVS_3
+#else
+#error "CLOCK_SMCLK_DIV: 1, 2, 4 or 8"
+#endif
+
+#define CLOCK_FREQ      (CLOCK_MHZ * 1000000L)  // MCLK, Hz
+#define CLOCK_SMCLK_FREQ (CLOCK_FREQ / CLOCK_SMCLK_DIV)
+#define CLOCK_ACLK_FREQ 32768L
+
+#if CLOCK_SMCLK_FREQ % 1000000L
+#error "CLOCK_SMCLK_DIV: SMCLK must be a whole number of MHz for the slot clock"
+#endif
+
+// DCOCTL first, so no step on the way runs above the target rate
+#define CLOCK_INIT()    { DCOCTL = 0; BCSCTL1 = CLOCK_CALBC1; DCOCTL = CLOCK_CALDCO; BCSCTL2 = CLOCK_DIVS; }
+
+#endif /* CLOCK_H_ */
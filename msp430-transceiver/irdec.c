@@ -0,0 +1,254 @@
+#include "irdec.h"
+
+// Receive states, packet receiver
+#define RX_SYNC         0       // hunting for IR_SYNC
+#define RX_LEN          1
+#define RX_DATA         2
+#define RX_SUM          3
+
+// Packet receiver, ir_decode() only
+// rcvrstate - packet receiver state RX_*
+// rxbyte, rxbit - byte being assembled and its bit count
+// rxsync - line decoder state (Manchester phase, PDM symbol)
+// rxbuf, rxlen, rxpos, rxsum - payload being received
+static volatile unsigned int rcvrstate = RX_SYNC, rxbit = 0, rxsync = 0,
+        rxlen = 0, rxpos = 0;
+static unsigned char rxbyte = 0, rxsum = 0;
+static unsigned char rxbuf[IR_MAX_PAYLOAD];
+
+// Edge ring, filled from interrupts, drained by ir_decode()
+// edge_time - timestamp, edge_level - receiver output after the edge
+static uint16_t edge_time[IR_EDGES];
+static unsigned char edge_level[IR_EDGES];
+volatile unsigned int edge_head = 0, edge_tail = 0;
+
+// Pulse width decoder, main loop only
+// seg_start, seg_level - segment in progress
+// held_start, held_level, held - finished segment, kept back one edge so
+// a spike right after it can still be merged into it
+static uint16_t seg_start = 0, held_start = 0;
+static unsigned int seg_level = 1, held_level = 0, held = 0;
+
+// Lower bounds of 1..IR_MAX_SLOTS slots in ticks, +-half a slot
+static const uint16_t ir_bound[IR_MAX_SLOTS] = {
+    IR_TICKS(1), IR_TICKS(3), IR_TICKS(5), IR_TICKS(7), IR_TICKS(9),
+    IR_TICKS(11), IR_TICKS(13), IR_TICKS(15), IR_TICKS(17), IR_TICKS(19),
+    IR_TICKS(21), IR_TICKS(23)
+};
+
+// Add an edge to the ring, interrupts only. Dropped when full.
+void ir_push(uint16_t t, unsigned int level)
+{
+    unsigned int next = (edge_head + 1) & (IR_EDGES - 1);
+
+    if (next != edge_tail)
+    {
+        edge_time[edge_head] = t;
+        edge_level[edge_head] = level;
+        edge_head = next;
+    }
+}
+
+// Feed one received byte to the packet receiver
+static void rx_packet(unsigned char byte)
+{
+    switch (rcvrstate)
+    {
+    case RX_SYNC:
+        if (byte == IR_SYNC)
+            rcvrstate = RX_LEN;
+        break;
+    case RX_LEN:
+        if (byte > IR_MAX_PAYLOAD)
+        { // Not a length, hunt again
+            rcvrstate = RX_SYNC;
+            break;
+        }
+        rxlen = byte;
+        rxpos = 0;
+        rxsum = byte;
+        rcvrstate = byte ? RX_DATA : RX_SUM;
+        break;
+    case RX_DATA:
+        rxbuf[rxpos++] = byte;
+        rxsum += byte;
+        if (rxpos == rxlen)
+            rcvrstate = RX_SUM;
+        break;
+    case RX_SUM:
+        if ((unsigned char) (rxsum + byte) == 0xFF)
+            ir_received(rxbuf, rxlen);
+        rcvrstate = RX_SYNC;
+        break;
+    }
+}
+
+#if IR_CODE != IR_CODE_NRZ
+// Bit stream codes: find IR_SYNC at any bit offset, then 8 bits per byte
+static void rx_bit(unsigned int bit)
+{
+    rxbyte = (rxbyte >> 1) | (bit << 7);
+    if (rcvrstate == RX_SYNC)
+    {
+        if (rxbyte == IR_SYNC)
+        {
+            rxbit = 0;
+            rx_packet(rxbyte);
+        }
+    }
+    else if (++rxbit == 8)
+    {
+        rxbit = 0;
+        rx_packet(rxbyte);
+    }
+}
+#endif
+
+// Forget a packet in progress
+static void rx_reset(void)
+{
+    rcvrstate = RX_SYNC;
+    rxbit = 0;
+    rxsync = 0;
+}
+
+// A run of n slots of one receiver level (carrier = 0) for the line code
+static void ir_run(unsigned int level, unsigned int n)
+{
+#if IR_CODE == IR_CODE_NRZ
+    unsigned int i = (n > IR_FRAME_BITS) ? IR_FRAME_BITS : n;
+
+    while (i--)
+    {
+        if (rxbit == 0)
+        { // Idle until a START bit
+            if (!level)
+                rxbit = 1;
+        }
+        else if (rxbit < IR_FRAME_BITS - 1)
+        { // Data bit
+            rxbyte = (rxbyte >> 1) | (level << 7);
+            rxbit++;
+        }
+        else
+        { // STOP bit
+            rxbit = 0;
+            if (level)
+                rx_packet(rxbyte);
+            else
+                rcvrstate = RX_SYNC; // Framing error
+        }
+    }
+#elif IR_CODE == IR_CODE_MANCHESTER
+    // rxsync: 0 - no bit sync, 1 - run started on a bit boundary,
+    // 2 - run started in the middle of a bit. Mid bit edges carry the
+    // bit: the level before them is the bit value.
+    if (n == 2 && rxsync != 1)
+    { // A two slot run always ends in the middle of a bit
+        rx_bit(level);
+        rxsync = 2;
+    }
+    else if (n == 1 && rxsync == 1)
+    {
+        rx_bit(level);
+        rxsync = 2;
+    }
+    else if (n == 1 && rxsync == 2)
+    {
+        rxsync = 1;
+    }
+    else if (n != 1)
+    {
+        rxsync = 0;
+    }
+#elif IR_CODE == IR_CODE_PDM
+    // rxsync: 0 - wait for leader, 1 - leader on, 2 - data
+    if (!level)
+    { // Carrier
+        if (n >= IR_PDM_LEADER_ON - 1 && n < IR_MAX_SLOTS)
+            rxsync = 1;
+        else if (n != 1 || rxsync != 2)
+            rxsync = 0;
+    }
+    else if (rxsync == 1)
+    {
+        rxsync = (n == IR_PDM_LEADER_OFF) ? 2 : 0;
+    }
+    else if (rxsync == 2)
+    {
+        if (n == 1 || n == 3)
+            rx_bit(n == 3);
+        else
+            rxsync = 0;
+    }
+#endif
+    if (n >= IR_MAX_SLOTS) // Idle line, whatever was going on is over
+        rx_reset();
+}
+
+// Pulse width in ticks to slots, 0 for a spike
+static unsigned int ir_slots(uint16_t ticks)
+{
+    unsigned int n = 0;
+
+    while (n < IR_MAX_SLOTS && ticks >= ir_bound[n])
+        n++;
+    return n;
+}
+
+// One edge from the ring: close the segment it ends
+static void ir_edge(uint16_t t, unsigned int level)
+{
+    unsigned int n;
+
+    if (level == IR_EDGE_RESET)
+    { // Timer restarted after sending
+        seg_start = t;
+        seg_level = 1;
+        held = 0;
+        rx_reset();
+        return;
+    }
+    n = ir_slots((uint16_t) (t - seg_start));
+    if (level == seg_level)
+    { // Idle pseudo edge from the beat: flush everything
+        if (held)
+            ir_run(held_level, ir_slots((uint16_t) (seg_start - held_start)));
+        ir_run(seg_level, n);
+        held = 0;
+        seg_start = t;
+        return;
+    }
+    if (n == 0 && held)
+    { // Spike: the held segment goes on through it
+        seg_start = held_start;
+        seg_level = held_level;
+        held = 0;
+        return;
+    }
+    if (held)
+        ir_run(held_level, ir_slots((uint16_t) (seg_start - held_start)));
+    held = (n != 0);
+    held_start = seg_start;
+    held_level = seg_level;
+    seg_start = t;
+    seg_level = level;
+}
+
+// Drain the edge ring through the decoder, main loop only
+void ir_decode(void)
+{
+    unsigned int tail;
+
+    while ((tail = edge_tail) != edge_head)
+    {
+        ir_edge(edge_time[tail], edge_level[tail]);
+        edge_tail = (tail + 1) & (IR_EDGES - 1);
+    }
+}
+
+// A packet is being received (past its SYNC byte)
+int ir_receiving(void)
+{
+    return rcvrstate != RX_SYNC;
+}
@@ -0,0 +1,67 @@
+#ifndef IRDEC_H_
+#define IRDEC_H_
+
+// IR packet link: line codes, framing and the receive decoder.
+// Nothing in here touches the hardware. The decoder is fed edge
+// timestamps through ir_push() and reports packets to ir_received(),
+// so it runs the same on the target and on a host replaying traces
+// (tools/irbench.c). Timestamps are uint16_t and wrap like the 16-bit
+// timer they come from, on any host.
+
+#include <stdint.h>
+#include "clock.h"
+
+// IR packet: PREAMBLE.. SYNC LEN PAYLOAD[LEN] CHECKSUM, bytes LSB first.
+// CHECKSUM makes the 8-bit sum of LEN, PAYLOAD and CHECKSUM 0xFF.
+// On the air everything is made of slots of IR_BIT_WDT watchdog intervals
+// of SMCLK / 512, carrier on or off. The line code is a build option:
+//  NRZ        - START (carrier) D0..D7 (carrier = 0) STOP, 1 slot per bit
+//  PDM        - NEC style pulse distance: leader 8 on 4 off, then per bit
+//               1 on + 1 off (0) or 1 on + 3 off (1), 1 on at the end
+//  MANCHESTER - 2 slots per bit, 0 = on/off, 1 = off/on
+#define IR_CODE_NRZ         0
+#define IR_CODE_PDM         1
+#define IR_CODE_MANCHESTER  2
+#ifndef IR_CODE
+#define IR_CODE         IR_CODE_NRZ
+#endif
+
+#define IR_SMCLK_FREQ   CLOCK_SMCLK_FREQ // slot clock source
+#ifndef IR_TICK_FREQ
+#define IR_TICK_FREQ    32768L  // edge timestamps, ACLK on the target
+#endif
+
+#define IR_SLOT_US      512     // slot, ~1950 bit/s NRZ
+#define IR_BIT_WDT      (IR_SLOT_US * (IR_SMCLK_FREQ / 1000000L) / 512) // SMCLK / 512 intervals per slot
+#if IR_BIT_WDT == 0 || IR_BIT_WDT * 512L != IR_SLOT_US * (IR_SMCLK_FREQ / 1000000L)
+#error "IR_SLOT_US: not a whole number of watchdog intervals at this SMCLK"
+#endif
+#define IR_FRAME_BITS   10      // NRZ: START, 8 data, STOP
+#define IR_PDM_LEADER_ON  8
+#define IR_PDM_LEADER_OFF 4
+#define IR_PREAMBLE     0x55    // lets the receiver AGC settle
+#define IR_PREAMBLE_LEN 2
+#define IR_SYNC         0xD3
+#define IR_MAX_PAYLOAD  16
+
+// Receiver: edges are timestamped on both transitions of the receiver
+// output. Pulse widths are rounded to slots, a pulse under half a slot
+// is a spike and is dropped, IR_MAX_SLOTS or more is an idle line.
+#define IR_TICKS(halves) ((unsigned int) ((halves) * IR_TICK_FREQ * IR_SLOT_US / 2000000L))
+#define IR_MAX_SLOTS    12
+#define IR_EDGES        16      // edge ring, power of two
+#define IR_EDGE_RESET   2       // edge level: timer restarted, forget the past
+
+// Edge ring indices, written by ir_push() and ir_decode() only
+extern volatile unsigned int edge_head, edge_tail;
+
+// Function definitions:
+
+void ir_push(uint16_t t, unsigned int level);
+void ir_decode(void);
+int ir_receiving(void);
+
+// Supplied by the application, packet with a good checksum
+void ir_received(const unsigned char *data, unsigned int len);
+
+#endif /* IRDEC_H_ */
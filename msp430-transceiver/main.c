@@ -1,26 +1,56 @@
 // Simple IR Transceiver
 
 // Pinout:
-// P1.[0..3] - Common anode LEDs
-
+// P1.[0,1,3] - Common anode LEDs 1, 2, 4
+// P1.2 - 38kHz IR RECEIVER (TA0.1 / CCI1A capture)
+// P1.4 - Common anode LED 3 (was P1.2)
+// P1.5 - IR LED OUTPUT (TA0.0, 38kHz carrier)
 // P1.6 - RX LED
 // P1.7 - TX LED
 
 // P2.0 - 1. button
 // P2.1 - 2. button
 // P2.2 - 3. button
-// P2.3 - 4. button
-// P2.4 - IR LED OUTPUT
-// P2.5 - 38kHz IR RECEIVER
+// P2.3 - 4. button (sends the last consumer IR frame received, if any)
+// P2.4 - not used (was IR LED)
+// P2.5 - not used (was IR RECEIVER)
 
 #include <msp430g2452.h>
+#include "cir.h"
+#include "irdec.h"
+#include "trace.h"
+#include "clock.h"
 
 #define BEAT_FREQ       512
-#define BUTDEB_LEN      (BEAT_FREQ / 4)
+// Buttons are sampled once per beat and debounced by 2-bit vertical
+// counters, one bit per button in each counter word: a button changes
+// state after 4 samples in a row (~8ms) that differ from its debounced
+// state. All buttons are done at once, up to 16 with unsigned int.
+#define BUTTONS         0x0F    // P2.0 - P2.3, button n is bit n - 1
+#define BUT_CIR         0x08    // 4. button, sends the learned CIR frame
 // #define MAX_STATE       9
-#define STATE_LEN       4
 
 #define WAIT_TIME       BEAT_FREQ
+
+// IR carrier: Timer_A up mode on SMCLK, TA0.0 toggles on every CCR0 match
+#define SMCLK_FREQ      CLOCK_SMCLK_FREQ
+#define CARRIER_FREQ    38000
+#define CARRIER_CCR0    ((SMCLK_FREQ + CARRIER_FREQ) / (2 * CARRIER_FREQ) - 1)
+#define IR_LED          BIT5    // P1.5 / TA0.0
+#define IR_RX           BIT2    // P1.2 / CCI1A
+
+// Own packets: format and line code (IR_CODE) in irdec.h
+#define IR_PERIOD       BEAT_FREQ // beats between button state packets
+#define IR_WDT          WDT_MDLY_0_5 // SMCLK / 512, IR_BIT_WDT of them per slot
+#define WDT_PER_BEAT    ((SMCLK_FREQ / 512 + BEAT_FREQ / 2) / BEAT_FREQ) // intervals per beat while sending
+#if CIR_WDT_DIV == 64
+#define CIR_WDT         WDT_MDLY_0_064
+#else
+#define CIR_WDT         WDT_MDLY_0_5
+#endif
+#define CIR_WDT_PER_BEAT ((SMCLK_FREQ / CIR_WDT_DIV + BEAT_FREQ / 2) / BEAT_FREQ) // consumer IR
+#define CIR_QUEUE       4       // consumer IR symbols made ahead, power of two
+
 // Transmitter
 #define EN_TX   0x7F
 #define DIS_TX  0xFF
@@ -32,116 +62,350 @@
 #define ERROR_STATE     5
 
 // Transmitter
-// xmit - flag to start 38kHz IR LED modulation
-// xmitstate - state machine for serial protocol
-// trnsm_currstate - currently selected data (button state) [0-3]
-// savestate - Prevent transm_currstate state from changing during xmit
-// butdeb - Button debounce counters
-volatile int xmit = 0, xmitstate = 0, trnsm_currstate = 0, savestate = 0,
-        butdeb[4] = { 0, 0, 0, 0 };
+// xmitstate - beats since last button state packet
+// trnsm_currstate - buttons pressed while the state is held, BUTTONS mask
+volatile int xmitstate = 0, trnsm_currstate = 0;
+
+// Button debouncer, beat only
+// butstate - debounced buttons, 1 = pressed
+// butct0, butct1 - low and high bits of the per-button counters
+unsigned int butstate = 0, butct0 = ~0, butct1 = ~0;
+
+// txbuf - frame being sent, built by ir_send()
+// txlen - bytes in txbuf, 0 when idle
+// txpos, txbit - byte and bit being sent
+// txrun, txphase, txcarrier - PDM symbol being sent
+// txdiv, beatdiv - watchdog intervals into the current slot and beat
+// txcir - a consumer IR frame is being sent instead of txbuf
+unsigned char txbuf[IR_PREAMBLE_LEN + 3 + IR_MAX_PAYLOAD];
+volatile unsigned int txlen = 0, txpos = 0, txbit = 0, txrun = 0, txphase = 0,
+        txcarrier = 0, txdiv = 0, beatdiv = 0, txcir = 0;
+
+// Consumer IR sending. A watchdog interval is 64 cycles at 1MHz, so the
+// interrupt only counts a symbol down; main makes the symbols ahead with
+// cir_symbol() and the beats owed meanwhile run after the frame.
+// cirq_run, cirq_carrier - symbols made by main, taken by the watchdog
+// cirq_head, cirq_tail - queue indices, main and watchdog only
+// cirq_done - main has queued the end of the frame
+// cir_left - watchdog intervals left in the symbol on the air
+// beats_owed - beats due while the frame was sent
+unsigned char cirq_run[CIR_QUEUE];
+signed char cirq_carrier[CIR_QUEUE];
+volatile unsigned char cirq_head = 0, cirq_tail = 0, cirq_done = 0, cir_left = 0;
+volatile unsigned int beats_owed = 0;
+
+// Consumer IR, learned from a remote and sent again by button 4
+// cir_learned - protocol of the last frame received, -1 for none
+// cir_code - its code
+// cir_replay - button 4 pressed, send it when the transmitter is free
+volatile int cir_learned = -1;
+volatile unsigned long cir_code = 0;
+volatile unsigned int cir_replay = 0;
 
 // Receiver
-// rcvr_currstate - currently received data (led state) [0-3]
+// rcvr_currstate - currently received data, BUTTONS mask shown on the LEDs
 // txmask - mask to set transmitter led on/off
 // rxmask - mask to set receiver led on/off
 // txhold_counter - hold transmitter state for a while
 // rxhold_counter - hold receiver state for a while
-volatile unsigned int rcvr_currstate = 0, rcvrstate = 0, newstate = 0,
-        stateage = 0, txmask = DIS_TX, rxmask = DIS_RX, txhold_counter = 0,
-        rxhold_counter = 0;
+volatile unsigned int rcvr_currstate = 0, stateage = 0, txmask = DIS_TX,
+        rxmask = DIS_RX, txhold_counter = 0, rxhold_counter = 0;
 
 // Common anode LED states.  Active low. {[0-3], [All led's on - ERROR]}
 
 // 0xFF - NORMAL state (All LEDs off)
-// 0xFO - ERROR  state (All LEDs on)
-unsigned const char leds[] = { 0xFF, 0xFE, 0xFD, 0xFB, 0xF7, 0xF0 };
+// 0xE4 - ERROR  state (All LEDs on)
+// Idle pseudo edge from the beat
+// last_edge - ACLK time of the last captured edge
+// idle_sent - pushed since then
+volatile unsigned int last_edge = 0, idle_sent = 0;
+
+unsigned const char leds[] = { 0xFF, 0xFE, 0xFD, 0xEF, 0xF7, 0xE4 };
+
+void receive_mode(void);
+void transmit_mode(unsigned int ccr0, unsigned int wdt);
+int ir_send(const unsigned char *data, unsigned int len);
+int ir_send_cir(unsigned int proto, unsigned long code);
+void cir_fill(void);
 
 void main(void)
 {
     WDTCTL = WDTPW | WDTHOLD;   // stop watchdog timer
     //WDTCTL = WDTPW + WDTHOLD; // Stop watchdog timer
-    BCSCTL1 = CALBC1_1MHZ;
-    DCOCTL = CALDCO_1MHZ;
+    CLOCK_INIT();
 
     // P1DIR = 0xFF; // Set P1 to output direction
-    P1DIR = 0xCF; // Set P1 to output direction
+    P1DIR = 0xFB; // Set P1 to output direction (P1.2 - IR receiver)
     // P1OUT = 0xFF; // Set the LEDs off
-    P1OUT = 0xCF; // Set the LEDs off
+    P1OUT = 0xDB; // Set the LEDs off
+    P1SEL = IR_RX; // Receiver to CCI1A
     // P2DIR = 0xFC; // Set P2.0/1 to input for buttons
-    P2DIR = 0xD0; // Set P2.0/1/2/3/5 to input for buttons
+    P2DIR = 0xF0; // Set P2.0/1/2/3 to input for buttons
     // P2OUT = 0x20; // Set IR LED off
-    P2OUT = 0x10; // Set IR LED off
+    P2OUT = 0x00; // P2.4/5 unused, low
     // P2REN = 0x03; // Enable pulldown resistors
     P2REN = 0x0F; // Enable pulldown resistors
     // P2IES = 0x03; // Positive edge trigger
-    P2IES = 0x2F; // Negative edge trigger
     P2IFG = 0x00; // Clear pin change interrupt flags
     // P2IE = 0x03; // Enable button interrupts
-    P2IE = 0x2F; // Enable button interrupts
-
-    TACTL = TASSEL_1 | MC_1; // Set the timer A to ACLK, Up mode
-    TACCR0 = (0x8000 / BEAT_FREQ) - 1; // Reset timer at BEAT frequency
-    TACCTL0 = CCIE; // Clear the timer and enable timer interrupt
+    P2IE = 0x00; // Buttons are polled by the beat
 
-    __enable_interrupt();
-    //_BIS_SR(LPM1_bits + GIE);
+    receive_mode();
+    IE1 |= WDTIE;
 
     while (1)
     {
-        while (xmit)
-        {
-            // Delay some cycles to keep frequency at 38kHz
-            // This is much less than expected due to the
-            // lost time to the while loop's condition test
-            // and the bitwise math on P2OUT
-            // This value was found with an oscilloscope.
-            __delay_cycles(2);
-            //P2OUT ^= BIT5;
-            P2OUT ^= BIT4;
+        __disable_interrupt();
+        if (edge_tail == edge_head && (!txcir || cirq_done
+                || ((cirq_head + 1) & (CIR_QUEUE - 1)) == cirq_tail))
+        { // SMCLK only while the carrier runs, LPM3 otherwise
+            __bis_SR_register((txlen ? LPM0_bits : LPM3_bits) + GIE);
+            continue;
         }
-        // Turn off IR LED
-        //P2OUT &= ~BIT5;
-        P2OUT &= ~BIT4;
+        __enable_interrupt();
+        cir_fill();
+        TRACE_ENTER(TRACE_DECODE);
+        ir_decode();
+        TRACE_EXIT(TRACE_DECODE);
     }
 }
 
-// Timer A0 interrupt service routine
-#pragma vector=TIMER0_A0_VECTOR
-__interrupt void Timer0_A0(void)
+// Between packets: beat from the watchdog (ACLK / 64 = BEAT_FREQ),
+// IR LED off, Timer_A continuous on ACLK capturing receiver edges
+void receive_mode(void)
 {
-    // Transmitter
-    xmitstate = (xmitstate + 1) % BEAT_FREQ;
-
-    // Set transmit flag for START BIT3 BIT2 BIT1 BIT0 STOP
-    if (xmitstate == 0 || xmitstate == (STATE_LEN + 1))
-    { // START & STOP bits
-        xmit = 1;
-        txmask = EN_TX;
-        savestate = trnsm_currstate; // Prevent state from changing during xmit
+    P1SEL &= ~IR_LED;
+    TACCTL0 = 0;
+    TACTL = TASSEL_1 | MC_2 | TACLR | TRACE_TAIE;
+    TACCTL1 = CM_3 | CCIS_0 | SCS | CAP | CCIE;
+    WDTCTL = WDT_ADLY_1_9;
+    TRACE_MARK(TRACE_TX);
+    last_edge = 0;
+    idle_sent = 0;
+    ir_push(0, IR_EDGE_RESET);
+    cir_reset();
+}
+
+// During a packet: carrier on TA0.0 (CARRIER_CCR0 for our own packets),
+// watchdog is the slot clock, receiver stopped
+void transmit_mode(unsigned int ccr0, unsigned int wdt)
+{
+    TRACE_HOLD(TRACE_TX);
+    TACCTL1 = 0;
+    TACTL = TASSEL_2 | MC_1 | TACLR;
+    TACCR0 = ccr0;
+    TACCTL0 = OUTMOD_4; // Toggle TA0.0 on CCR0
+    WDTCTL = wdt;
+}
+
+// Frame and start sending a packet of up to IR_MAX_PAYLOAD bytes.
+// Returns 0 while the previous packet is still on the air. Call from
+// an interrupt, main picks LPM0 for the carrier when it returns.
+int ir_send(const unsigned char *data, unsigned int len)
+{
+    unsigned int i;
+    unsigned char sum = len;
+
+    if (txlen || len > IR_MAX_PAYLOAD)
+        return 0;
+    for (i = 0; i < IR_PREAMBLE_LEN; i++)
+        txbuf[i] = IR_PREAMBLE;
+    txbuf[i++] = IR_SYNC;
+    txbuf[i++] = len;
+    while (len--)
+    {
+        sum += *data;
+        txbuf[i++] = *data++;
     }
-    else if (xmitstate < (STATE_LEN + 1))
-    { // 4 bits of state MSBF
-        xmit = !((savestate >> (STATE_LEN - xmitstate)) & 0x1);
+    txbuf[i++] = ~sum;
+    txpos = txbit = txrun = txphase = txdiv = beatdiv = 0;
+    transmit_mode(CARRIER_CCR0, IR_WDT);
+    txlen = i;
+    return 1;
+}
+
+// Start sending a consumer IR frame (CIR_NEC, CIR_RC5, CIR_SIRC) on its
+// own carrier, slots of SMCLK / CIR_WDT_DIV. Same rules as ir_send().
+int ir_send_cir(unsigned int proto, unsigned long code)
+{
+    if (txlen || proto >= CIR_PROTOS)
+        return 0;
+    cir_start(proto, code);
+    cirq_head = cirq_tail = cirq_done = 0;
+    cir_left = 1;                       // off until main has queued symbols
+    txdiv = beatdiv = 0;
+    txcir = 1;
+    transmit_mode(cir_protos[proto].carrier, CIR_WDT);
+    txlen = 1;
+    return 1;
+}
+
+// Queue consumer IR symbols up to CIR_QUEUE - 1 ahead, main loop only
+void cir_fill(void)
+{
+    unsigned char head, run;
+
+    while (txcir && !cirq_done
+            && (((head = cirq_head) + 1) & (CIR_QUEUE - 1)) != cirq_tail)
+    {
+        run = 0;
+        cirq_carrier[head] = cir_symbol(&run);
+        cirq_run[head] = run;
+        if (cirq_carrier[head] < 0)
+            cirq_done = 1;
+        cirq_head = (head + 1) & (CIR_QUEUE - 1);
     }
+}
+
+// Carrier for the next slot, -1 when the packet is over
+int tx_slot(void)
+{
+    unsigned int bit;
+#if IR_CODE == IR_CODE_MANCHESTER
+    unsigned int half;
+#endif
+
+#if IR_CODE == IR_CODE_NRZ
+    if (txpos == txlen)
+        return -1;
+    if (txbit == 0)
+        bit = 0; // START
+    else if (txbit < IR_FRAME_BITS - 1)
+        bit = (txbuf[txpos] >> (txbit - 1)) & 0x01;
     else
+        bit = 1; // STOP
+    if (++txbit == IR_FRAME_BITS)
+    {
+        txbit = 0;
+        txpos++;
+    }
+    return !bit;
+#elif IR_CODE == IR_CODE_MANCHESTER
+    if (txpos == txlen)
+        return -1;
+    bit = (txbuf[txpos] >> (txbit >> 1)) & 0x01;
+    half = txbit & 0x01;
+    if (++txbit == 16)
     {
-        xmit = 0;
-        txmask = DIS_TX;
+        txbit = 0;
+        txpos++;
     }
+    return half ? bit : !bit;
+#elif IR_CODE == IR_CODE_PDM
+    if (txrun == 0)
+    {
+        switch (txphase)
+        {
+        case 0: // Leader on
+            txcarrier = 1;
+            txrun = IR_PDM_LEADER_ON;
+            txphase = 1;
+            break;
+        case 1: // Leader off
+            txcarrier = 0;
+            txrun = IR_PDM_LEADER_OFF;
+            txphase = 2;
+            break;
+        case 2: // Mark of the next bit, or the final one
+            txcarrier = 1;
+            txrun = 1;
+            txphase = (txpos == txlen) ? 4 : 3;
+            break;
+        case 3: // Space, its length is the bit
+            bit = (txbuf[txpos] >> txbit) & 0x01;
+            txcarrier = 0;
+            txrun = bit ? 3 : 1;
+            if (++txbit == 8)
+            {
+                txbit = 0;
+                txpos++;
+            }
+            txphase = 2;
+            break;
+        default:
+            return -1;
+        }
+    }
+    txrun--;
+    return txcarrier;
+#else
+#error "IR_CODE"
+#endif
+}
+
+// Packet received with a good checksum
+void ir_received(const unsigned char *data, unsigned int len)
+{
+    if (len)
+    {
+        rcvr_currstate = data[0];
+        stateage = 0;
+    }
+}
+
+// Consumer IR frame decoded by cir_edge(), capture interrupt
+void cir_received(unsigned int proto, unsigned long code)
+{
+    cir_learned = proto;
+    cir_code = code;
+}
+
+// Sample and debounce all buttons, returns the ones that went down
+unsigned int button_scan(void)
+{
+    unsigned int delta = (P2IN & BUTTONS) ^ butstate;
+
+    butct0 = ~(butct0 & delta);         // count down where the input differs,
+    butct1 = butct0 ^ (butct1 & delta); // back to 3 where it agrees
+    delta &= butct0 & butct1;           // wrapped to 3: 4 samples in a row
+    butstate ^= delta;
+    return butstate & delta;
+}
+
+// LED pattern for a set of buttons, LED n for button n
+unsigned char button_leds(unsigned int buttons)
+{
+    unsigned int i;
+    unsigned char pattern = leds[0];
+
+    for (i = 1; buttons; i++, buttons >>= 1)
+        if (buttons & 0x01)
+            pattern &= leds[i];
+    return pattern;
+}
+
+// Once per beat
+void beat(void)
+{
+    unsigned int pressed;
+
+    // Transmitter
+    // Button state packet once per IR_PERIOD beats
+    xmitstate = (xmitstate + 1) % IR_PERIOD;
+    if (xmitstate == 0)
+    {
+        unsigned char state = trnsm_currstate;
+        ir_send(&state, 1);
+    }
+    if (cir_replay && ir_send_cir(cir_learned, cir_code))
+        cir_replay = 0;
+    txmask = txlen ? EN_TX : DIS_TX;
+
     // Update display
     // P1OUT = leds[trnsm_currstate] & txmask;
 
-    // Decrement debounce counters, but only to zero
-    butdeb[0] ? butdeb[0]-- : 1;
-    //    if (butdeb[0]){
-    //        butdeb[0] = butdeb[0] - 1;
-    //    } else {
-    //        1;
-    //    }
-
-    butdeb[1] ? butdeb[1]-- : 1;
-    butdeb[2] ? butdeb[2]-- : 1;
-    butdeb[3] ? butdeb[3]-- : 1;
+    // Buttons pressed together all go into the state
+    pressed = button_scan();
+    if ((pressed & BUT_CIR) && cir_learned >= 0)
+    {
+        cir_replay = 1;
+        pressed &= ~BUT_CIR;
+    }
+    if (pressed)
+    {
+        trnsm_currstate |= pressed;
+        txhold_counter = WAIT_TIME;
+    }
 
     // Hold transmitter state for WAIT_TIME cycle
     if (txhold_counter == 0)
@@ -163,14 +427,27 @@ __interrupt void Timer0_A0(void)
         rcvr_currstate = 0;
     }
 
+    // Receiver quiet for a while: let the decoder finish the last run
+    if (!txlen && !idle_sent)
+    {
+        unsigned int t;
+        do
+            t = TAR; // ACLK is asynchronous to MCLK
+        while (t != TAR);
+        if (t - last_edge >= IR_TICKS(2 * IR_MAX_SLOTS))
+        {
+            ir_push(t, (TACCTL1 & CCI) ? 1 : 0);
+            idle_sent = 1;
+        }
+    }
+
     rxmask = DIS_RX;
-    if (rcvrstate > 1)
+    if (ir_receiving())
         rxmask = EN_RX;
 
-    if (rcvr_currstate == 1 || rcvr_currstate == 2 || rcvr_currstate == 3
-            || rcvr_currstate == 4)
+    if (rcvr_currstate & BUTTONS)
     { // Hold last received state for WAIT_TIME cycle
-        P1OUT = leds[rcvr_currstate] & txmask & rxmask;
+        P1OUT = button_leds(rcvr_currstate & BUTTONS) & txmask & rxmask & ~IR_LED;
         rxhold_counter = WAIT_TIME;
     }
 
@@ -178,7 +455,7 @@ __interrupt void Timer0_A0(void)
     {
         if (rxhold_counter == 0)
         {
-            P1OUT = leds[0] & txmask & rxmask;
+            P1OUT = leds[0] & txmask & rxmask & ~IR_LED;
         }
         else
         {
@@ -187,93 +464,123 @@ __interrupt void Timer0_A0(void)
     }
 }
 
-// Timer A1 interrupt service routine
-// Receiver
-// Sampling pulse for IR data
-#pragma vector=TIMER0_A1_VECTOR
-__interrupt void Timer_A1(void)
+// Watchdog interval interrupt service routine
+// BEAT_FREQ heartbeat, slot clock while a packet is sent
+#pragma vector=WDT_VECTOR
+__interrupt void Beat(void)
 {
-    // P2OUT ^= 0x01; // Debug tick
-    if (rcvrstate == 1)
-    { // Test for START bit
-        if (P2IN & 0x20)
-        { // No start bit
-            rcvrstate = 0;
-            P2IE |= 0x20;
-            TACCTL1 = 0;
-        }
+    unsigned int sending, head, tail;
+    int carrier;
+
+    if (cir_left > 1)
+    { // Consumer IR symbol still on the air, nothing else this interval
+        cir_left--;
+        return;
     }
-    else if (rcvrstate == STATE_LEN + 2)
-    { // Test for STOP bit
-        if (P2IN & 0x20)
-        { // No stop bit
-            rcvrstate = 0;
-            P2IE |= 0x20;
-            TACCTL1 = 0;
+    sending = txlen;
+    head = edge_head;
+    TRACE_ENTER(TRACE_BEAT);
+    if (txcir)
+    { // Symbol over: gate the next one first, then the bookkeeping
+        tail = cirq_tail;
+        if (tail == cirq_head)
+        { // Main is late, hold the line one more interval
+            cir_left = 1;
+        }
+        else
+        {
+            carrier = cirq_carrier[tail];
+            if (carrier > 0)
+                P1SEL |= IR_LED;
+            else
+                P1SEL &= ~IR_LED;
+            cir_left = cirq_run[tail];
+            cirq_tail = (tail + 1) & (CIR_QUEUE - 1);
+            beatdiv += cir_left;
+            while (beatdiv >= CIR_WDT_PER_BEAT)
+            {
+                beatdiv -= CIR_WDT_PER_BEAT;
+                beats_owed++;
+            }
+            if (carrier < 0)
+            { // Frame sent
+                cir_left = 0;
+                txlen = 0;
+                txcir = 0;
+                receive_mode();
+            }
         }
+        __bic_SR_register_on_exit(LPM3_bits); // room in the queue
     }
-    else if (rcvrstate == STATE_LEN + 3)
-    { // Finish receive
-        rcvrstate = 0;
-        P2IE |= 0x20;
-        TACCTL1 = 0;
-        rcvr_currstate = newstate;
-        stateage = 0;
+    else if (!txlen)
+    {
+        beat();
+        if (beats_owed)
+        { // Catch up on the beats of the last consumer IR frame
+            beats_owed--;
+            beat();
+        }
     }
     else
-    { // State bit
-        newstate = (newstate << 1) | ((P2IN >> 5) & 0x01);
+    { // Beat divided down from the slot clock
+        if (++txdiv >= IR_BIT_WDT)
+        {
+            txdiv = 0;
+            carrier = tx_slot();
+            // Gate the carrier: TA0.0 on the pin, or GPIO low (IR LED off)
+            if (carrier > 0)
+                P1SEL |= IR_LED;
+            else
+                P1SEL &= ~IR_LED;
+            if (carrier < 0)
+            { // Packet sent
+                txlen = 0;
+                receive_mode();
+            }
+        }
+        if (txlen && ++beatdiv >= WDT_PER_BEAT)
+        {
+            beatdiv = 0;
+            beat();
+        }
     }
-    rcvrstate++;
-    TAIV &= ~(0x02); // CLEAR INTERRUPT
+
+    // Main picks LPM0/LPM3 again and decodes new edges
+    if (!sending != !txlen || head != edge_head)
+        __bic_SR_register_on_exit(LPM3_bits);
+    TRACE_EXIT(TRACE_BEAT);
 }
 
-#pragma vector=PORT2_VECTOR
-__interrupt void Port2(void)
+// Timer A1 interrupt service routine
+// Receiver
+// Both edges of the IR receiver captured into the ring for our packets,
+// consumer IR frames are decoded right here, a step per edge
+#pragma vector=TIMER0_A1_VECTOR
+__interrupt void Timer_A1(void)
 {
-    // Transmitter
-    if ((P2IFG & 0x01) && !butdeb[0])
-    { // 1. button pressed
-        butdeb[0] = BUTDEB_LEN;
-        // currstate = currstate ? (currstate - 1) : MAX_STATE;
-        trnsm_currstate = 1;
-        txhold_counter = WAIT_TIME;
-    }
-    else if ((P2IFG & 0x02) && !butdeb[1])
-    { // 2. button pressed
-        butdeb[1] = BUTDEB_LEN;
-        // currstate = (currstate + 1) % (MAX_STATE + 1);
-        trnsm_currstate = 2;
-        txhold_counter = WAIT_TIME;
-    }
-    else if ((P2IFG & 0x04) && !butdeb[2])
-    { // 3. button pressed
-        butdeb[2] = BUTDEB_LEN;
-        // currstate = (currstate + 1) % (MAX_STATE + 1);
-        trnsm_currstate = 3;
-        txhold_counter = WAIT_TIME;
-    }
-    else if ((P2IFG & 0x08) && !butdeb[3])
-    { // 4. button pressed
-        butdeb[3] = BUTDEB_LEN;
-        // currstate = (currstate + 1) % (MAX_STATE + 1);
-        trnsm_currstate = 4;
-        txhold_counter = WAIT_TIME;
-    }
+    unsigned int level, iv;
 
-    // Receiver
-    // Start bit edge
-    if (P2IFG & 0x20)
+    iv = TAIV;
+#if TRACE
+    if (iv == TAIV_TAIFG)                   // TRACE_CLOCK wrapped
     {
-        rcvrstate = 1; // Begin receive
-        newstate = 0;
-        // Set Timer0A1 to half a beat later
-        TACCR1 = (TAR + (0x8000 / 2 / BEAT_FREQ)) % (TACCR0 + 1);
-        TACCTL1 = CCIE;
-        // Turn off edge interrupt
-        P2IE &= ~0x20;
+        trace_wraps++;
+        return;
     }
-
-    // Clear pin change (button) interrupt flags
-    P2IFG = 0x00;
+#endif
+    TRACE_ENTER(TRACE_CAPTURE);
+    switch (iv)
+    {
+    case TAIV_TACCR1:
+        last_edge = TACCR1;
+        TRACE_DUE(TRACE_CAPTURE, last_edge);
+        level = (TACCTL1 & CCI) ? 1 : 0;
+        idle_sent = 0;
+        ir_push(last_edge, level);
+        cir_edge(last_edge, level);
+        TACCTL1 &= ~COV;
+        __bic_SR_register_on_exit(LPM3_bits);
+        break;
+    }
+    TRACE_EXIT(TRACE_CAPTURE);
 }
@@ -0,0 +1,55 @@
+#include "trace.h"
+
+#if TRACE
+
+trace_t trace_ring = { TRACE_MAGIC, TRACE_LEN, 0, TRACE_FREQ, { { 0, 0 } } };
+volatile unsigned int trace_wraps;          // TRACE_CLOCK overflows
+
+// TAR runs from ACLK, asynchronous to MCLK: read until two reads agree
+unsigned int trace_clock(void)
+{
+    unsigned int t;
+
+    do
+        t = TAR;
+    while (t != TAR);
+    return t;
+}
+
+// Record with interrupts off. A wrap not counted yet shows as the
+// overflow flag still set and a small count.
+static void put(unsigned int ev, unsigned int t)
+{
+    unsigned int i, w;
+
+    w = trace_wraps;
+    if (TRACE_WRAPPED && t < 0x8000)
+        w++;
+    i = trace_ring.head;
+    trace_ring.rec[i].ev = ev | ((w & TRACE_WRAP_MASK) << TRACE_WRAP_SHIFT);
+    trace_ring.rec[i].t = t;
+    trace_ring.head = (i + 1) & (TRACE_LEN - 1);
+}
+
+// Append a record with timestamp t, overwriting the oldest. Safe from
+// tasks and ISRs.
+void trace_put(unsigned int ev, unsigned int t)
+{
+    unsigned short state = __get_interrupt_state();
+
+    __disable_interrupt();
+    put(ev, t);
+    __set_interrupt_state(state);
+}
+
+// Append a record stamped now; clock and wrap count are read together
+void trace_now(unsigned int ev)
+{
+    unsigned short state = __get_interrupt_state();
+
+    __disable_interrupt();
+    put(ev, TRACE_CLOCK);
+    __set_interrupt_state(state);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+// ##################### Trace ring ###############################
+// Build with --define=TRACE=1 to record ISR and task entry/exit in
+// trace_ring, each record an event word and a TRACE_CLOCK timestamp.
+// With TRACE 0 the macros are empty and trace.c compiles to nothing.
+// Save trace_ring from the debugger (raw binary or TI data format) and
+// run tools/tracedump on it for duration, period, jitter and latency.
+// TRACE_CLOCK is Timer_A on ACLK while receiving, ~30us ticks that
+// wrap after 2s; the Timer_A1 interrupt counts the wraps into the
+// records. While a packet is sent Timer_A makes the carrier, so
+// transmit_mode() puts a HOLD and receive_mode() a MARK in the ring.
+
+#include <msp430g2452.h>
+
+#ifndef TRACE
+#define TRACE 0
+#endif
+
+#ifndef TRACE_LEN
+#define TRACE_LEN       16                  // records, power of two
+#endif
+#define TRACE_MAGIC     0x7ACF              // 0x7ACE: records without wrap count
+#define TRACE_CLOCK     trace_clock()
+#define TRACE_WRAPPED   (TACTL & TAIFG)     // overflow not counted yet
+#define TRACE_FREQ      32768L              // TRACE_CLOCK ticks per second
+
+// Event word: kind in bits 15..13, TRACE_CLOCK wraps (mod 512) in 12..4,
+// source in 3..0. The wrap count makes timestamps 25 bits wide.
+#define TRACE_EV_ENTER  0x0000
+#define TRACE_EV_EXIT   0x2000
+#define TRACE_EV_DUE    0x4000              // inside ENTER/EXIT: when the source was due
+#define TRACE_EV_MARK   0x6000              // timestamps restart here
+#define TRACE_EV_HOLD   0x8000              // timestamps void until the next MARK
+#define TRACE_WRAP_SHIFT 4
+#define TRACE_WRAP_MASK 0x01FF
+
+// Sources
+#define TRACE_BEAT      1                   // WDT, beat and slot clock
+#define TRACE_CAPTURE   2                   // Timer_A1, receiver edges
+#define TRACE_DECODE    3                   // main loop, ir_decode()
+#define TRACE_TX        4                   // transmit_mode() / receive_mode()
+
+// Layout read by tracedump, 16-bit little endian words
+typedef struct
+{
+    unsigned int magic;                     // TRACE_MAGIC
+    unsigned int len;                       // TRACE_LEN
+    unsigned int head;                      // next record written
+    unsigned long freq;                     // TRACE_FREQ
+    struct
+    {
+        unsigned int ev, t;
+    } rec[TRACE_LEN];
+} trace_t;
+
+#if TRACE
+extern trace_t trace_ring;
+extern volatile unsigned int trace_wraps;
+
+unsigned int trace_clock(void);
+void trace_put(unsigned int ev, unsigned int t);
+void trace_now(unsigned int ev);
+
+#define TRACE_ENTER(src)    trace_now(TRACE_EV_ENTER | (src))
+#define TRACE_EXIT(src)     trace_now(TRACE_EV_EXIT | (src))
+#define TRACE_DUE(src, t)   trace_put(TRACE_EV_DUE | (src), (t))
+#define TRACE_MARK(src)     trace_now(TRACE_EV_MARK | (src))
+#define TRACE_HOLD(src)     trace_put(TRACE_EV_HOLD | (src), 0)
+#define TRACE_TAIE          TAIE            // count TRACE_CLOCK wraps
+#else
+#define TRACE_ENTER(src)
+#define TRACE_EXIT(src)
+#define TRACE_DUE(src, t)
+#define TRACE_MARK(src)
+#define TRACE_HOLD(src)
+#define TRACE_TAIE          0
+#endif
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,75 @@
+// crctest - check the firmware's 1-Wire CRC8 (onewire.c ow_crc8) against
+// known good vectors
+//
+// Build, onewire.c taken as it is for the simulator (tools/sim):
+//   F=../msp430-tm1638-ds18b20
+//   cc -O2 -Wall -DHAL_SIM -Isim -I$F -o crctest crctest.c sim/stub.c $F/onewire.c
+// Usage:  crctest
+//
+// Vectors:
+//  rom         ROM code from Maxim AN27, 02 1C B8 01 00 00 00, CRC A2
+//  scratchpad  DS18B20 power-up scratchpad, 85 degC, 12 bits, CRC 1C
+//  corrupted   the scratchpad with bit 0 of byte 0 flipped
+// A good vector has to give its CRC byte over the data and 0 over data
+// and CRC, which is what ds18b20.c and the ROM search test. The corrupted
+// one has to fail, and so does every other single bit error in both.
+// Prints one line per check, exits 1 if any failed.
+//
+// Only ow_crc8() is called, no transfer runs: sim/stub.c stands in for
+// the simulator and stops the test if a register is touched.
+
+#define SIM_CORE
+#include <stdio.h>
+#include <string.h>
+#include "onewire.h"
+
+static const uint8_t rom[8] = {
+    0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xA2
+};
+static const uint8_t scratchpad[9] = {
+    0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0x1C
+};
+
+static int failed;
+
+static void check(const char *name, int ok)
+{
+    printf("%-40s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok)
+        failed = 1;
+}
+
+// Every single bit error in buf has to be caught
+static int all_flips_fail(const uint8_t *buf, unsigned int len)
+{
+    uint8_t copy[16];
+    unsigned int i;
+
+    for (i = 0; i < 8 * len; i++)
+    {
+        memcpy(copy, buf, len);
+        copy[i / 8] ^= 1 << (i % 8);
+        if (!ow_crc8(copy, len))
+            return 0;
+    }
+    return 1;
+}
+
+int main(void)
+{
+    uint8_t bad[9];
+
+    check("rom: CRC of the 7 data bytes is A2", ow_crc8(rom, 7) == 0xA2);
+    check("rom: 0 over all 8 bytes", ow_crc8(rom, 8) == 0);
+    check("scratchpad: CRC of the 8 data bytes is 1C",
+            ow_crc8(scratchpad, 8) == 0x1C);
+    check("scratchpad: 0 over all 9 bytes", ow_crc8(scratchpad, 9) == 0);
+
+    memcpy(bad, scratchpad, sizeof bad);
+    bad[0] ^= 0x01;                         // 50 -> 51
+    check("corrupted: not 0 over all 9 bytes", ow_crc8(bad, 9) != 0);
+
+    check("rom: every 1 bit error fails", all_flips_fail(rom, 8));
+    check("scratchpad: every 1 bit error fails", all_flips_fail(scratchpad, 9));
+    return failed;
+}
@@ -0,0 +1,380 @@
+// irbench - replay synthetic IR edge traces through the transceiver's
+// decoders (irdec.c for its own packets, cir.c for consumer IR)
+//
+// Build, IR_CODE as for the firmware (0 NRZ, 1 PDM, 2 Manchester):
+//   T=../msp430-transceiver
+//   cc -O2 -DIR_CODE=1 -I$T -o irbench irbench.c $T/irdec.c $T/cir.c -lm
+// Usage:  irbench [-c] [-n frames] [-j us] [-d rate] [-s rate] [-r seed]
+//
+// Frames are encoded slot by slot as the firmware sends them, turned
+// into receiver edges (level 0 = carrier) and timestamped in ACLK ticks
+// that wrap at 16 bits like TAR. The channel then adds:
+//  -j us    edge jitter, uniform +-us on every edge
+//  -d rate  dropouts, the chance that a mark is lost completely
+//  -s rate  noise, spikes per ms of air time, 5..40% of a slot wide
+// Between frames the line idles and the beat's idle pseudo edge is
+// pushed, as on the target. -c sends NEC / RC-5 / SIRC frames made by
+// cir_symbol() to cir_edge() instead of packets to ir_push()/ir_decode().
+// One line is printed: frames, good, bad (a frame decoded to the wrong
+// content), frame error rate and the decode cost in host ns per edge
+// and per frame. The cost only compares builds and line codes on this
+// host, it is not the MSP430 cycle count.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "irdec.h"
+#include "cir.h"
+
+#define MAX_EDGES       (1L << 22)
+
+typedef struct
+{
+    double t;                   // seconds
+    unsigned char level;        // receiver output after the edge, or IR_EDGE_RESET
+} edge_t;
+
+static edge_t *edges;
+static long nedges;
+static long *frame_end;         // first edge of the next frame
+
+static double jitter_us, drop_rate, spike_rate;
+static int cir_mode;
+
+// Expected content of the frame being replayed, and what came out
+static unsigned char want[IR_MAX_PAYLOAD];
+static unsigned int want_len, want_proto;
+static unsigned long want_code;
+static unsigned long good, bad;
+
+// ##### Random numbers #####
+
+static unsigned long rng = 1;
+
+static unsigned long rnd(void)
+{
+    rng ^= rng << 13;           // xorshift, 32 bits kept
+    rng &= 0xFFFFFFFFUL;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    rng &= 0xFFFFFFFFUL;
+    return rng;
+}
+
+static double uniform(void)
+{
+    return rnd() / 4294967296.0;
+}
+
+// ##### Encoders #####
+// Each fills a carrier per slot (1 = on), returns the number of slots
+
+#define MAX_SLOTS       4096
+
+static unsigned char slots[MAX_SLOTS];
+
+// Own packet, framed as ir_send() and line coded as tx_slot()
+static unsigned int encode_packet(const unsigned char *data, unsigned int len)
+{
+    unsigned char buf[IR_PREAMBLE_LEN + 3 + IR_MAX_PAYLOAD];
+    unsigned int i, n = 0, b, bit, pos;
+    unsigned char sum = len;
+
+    for (i = 0; i < IR_PREAMBLE_LEN; i++)
+        buf[i] = IR_PREAMBLE;
+    buf[i++] = IR_SYNC;
+    buf[i++] = len;
+    for (b = 0; b < len; b++)
+    {
+        sum += data[b];
+        buf[i++] = data[b];
+    }
+    buf[i++] = ~sum;
+
+#if IR_CODE == IR_CODE_NRZ
+    for (pos = 0; pos < i; pos++)
+        for (b = 0; b < IR_FRAME_BITS; b++)
+        {
+            if (b == 0)
+                bit = 0;
+            else if (b < IR_FRAME_BITS - 1)
+                bit = (buf[pos] >> (b - 1)) & 0x01;
+            else
+                bit = 1;
+            slots[n++] = !bit;
+        }
+#elif IR_CODE == IR_CODE_MANCHESTER
+    for (pos = 0; pos < i; pos++)
+        for (b = 0; b < 8; b++)
+        {
+            bit = (buf[pos] >> b) & 0x01;
+            slots[n++] = !bit;
+            slots[n++] = bit;
+        }
+#elif IR_CODE == IR_CODE_PDM
+    for (b = 0; b < IR_PDM_LEADER_ON; b++)
+        slots[n++] = 1;
+    for (b = 0; b < IR_PDM_LEADER_OFF; b++)
+        slots[n++] = 0;
+    for (pos = 0; pos < i; pos++)
+        for (b = 0; b < 8; b++)
+        {
+            bit = (buf[pos] >> b) & 0x01;
+            slots[n++] = 1;
+            slots[n++] = 0;
+            if (bit)
+            {
+                slots[n++] = 0;
+                slots[n++] = 0;
+            }
+        }
+    slots[n++] = 1;
+#else
+#error "IR_CODE"
+#endif
+    return n;
+}
+
+// Consumer IR frame, straight from the firmware's sender
+static unsigned int encode_cir(unsigned int proto, unsigned long code)
+{
+    unsigned int n = 0;
+    unsigned char run;
+    int carrier;
+
+    cir_start(proto, code);
+    while ((carrier = cir_symbol(&run)) >= 0)
+        while (run-- && n < MAX_SLOTS)
+            slots[n++] = carrier;
+    return n;
+}
+
+// ##### Channel #####
+
+static void put_edge(double t, unsigned int level)
+{
+    if (nedges >= MAX_EDGES)
+    {
+        fprintf(stderr, "irbench: too many edges\n");
+        exit(1);
+    }
+    edges[nedges].t = t;
+    edges[nedges].level = level;
+    nedges++;
+}
+
+// Slots from t on, slot seconds each: edges with jitter, dropped marks and
+// spikes. Returns the time the last slot ends.
+static double transmit(double t, unsigned int n, double slot)
+{
+    unsigned int i, j;
+    double start, end, jit = jitter_us * 1e-6;
+
+    for (i = 0; i < n; i = j)
+    {
+        for (j = i; j < n && slots[j] == slots[i]; j++)
+            ;
+        start = t + i * slot;
+        end = t + j * slot;
+        if (slots[i] && uniform() >= drop_rate)
+        { // Mark: receiver output low from start to end
+            put_edge(start + (2 * uniform() - 1) * jit, 0);
+            put_edge(end + (2 * uniform() - 1) * jit, 1);
+        }
+    }
+    return t + n * slot;
+}
+
+// Spikes of the other level over everything so far in [from, to)
+static void add_noise(long first, double from, double to, double slot)
+{
+    double t = from;
+    long i, k;
+    unsigned int level;
+
+    if (spike_rate <= 0)
+        return;
+    while (1)
+    {
+        t += -log(1 - uniform()) / (spike_rate * 1000);
+        if (t >= to)
+            break;
+        // Level on the line at t, from the edges of this frame
+        level = 1;
+        for (i = first; i < nedges && edges[i].t <= t; i++)
+            level = edges[i].level;
+        // Insert the spike in time order
+        if (nedges + 2 > MAX_EDGES)
+            break;
+        for (k = nedges + 1; k > i + 1; k--)
+            edges[k] = edges[k - 2];
+        edges[i].t = t;
+        edges[i].level = !level;
+        edges[i + 1].t = t + slot * (0.05 + 0.35 * uniform());
+        edges[i + 1].level = level;
+        nedges += 2;
+    }
+}
+
+// Order edges by time, jitter can swap neighbours
+static int by_time(const void *a, const void *b)
+{
+    const edge_t *x = a, *y = b;
+
+    return (x->t > y->t) - (x->t < y->t);
+}
+
+// ##### Decoder side #####
+
+void ir_received(const unsigned char *data, unsigned int len)
+{
+    if (!cir_mode && len == want_len && memcmp(data, want, len) == 0)
+        good++;
+    else
+        bad++;
+}
+
+void cir_received(unsigned int proto, unsigned long code)
+{
+    if (!cir_mode)
+        return;
+    if (proto == want_proto && code == want_code)
+        good++;
+    else
+        bad++;
+}
+
+static uint16_t ticks(double t)
+{
+    return (uint16_t) (unsigned long) floor(t * IR_TICK_FREQ);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: irbench [-c] [-n frames] [-j us] [-d rate] [-s rate] [-r seed]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long frames = 1000, f;
+    unsigned int n, i, len = 0;
+    unsigned char (*payload)[IR_MAX_PAYLOAD];
+    unsigned int *paylen, *protos;
+    unsigned long *codes;
+    double t, slot, start, ns;
+    long e, first;
+    struct timespec t0, t1;
+    int a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "-c") == 0)
+            cir_mode = 1;
+        else if (strcmp(argv[a], "-n") == 0 && a + 1 < argc)
+            frames = strtoul(argv[++a], 0, 0);
+        else if (strcmp(argv[a], "-j") == 0 && a + 1 < argc)
+            jitter_us = atof(argv[++a]);
+        else if (strcmp(argv[a], "-d") == 0 && a + 1 < argc)
+            drop_rate = atof(argv[++a]);
+        else if (strcmp(argv[a], "-s") == 0 && a + 1 < argc)
+            spike_rate = atof(argv[++a]);
+        else if (strcmp(argv[a], "-r") == 0 && a + 1 < argc)
+            rng = strtoul(argv[++a], 0, 0) | 1;
+        else
+            usage();
+    }
+    if (!frames)
+        usage();
+
+    edges = malloc(MAX_EDGES * sizeof *edges);
+    frame_end = malloc(frames * sizeof *frame_end);
+    payload = malloc(frames * sizeof *payload);
+    paylen = malloc(frames * sizeof *paylen);
+    protos = malloc(frames * sizeof *protos);
+    codes = malloc(frames * sizeof *codes);
+    if (!edges || !frame_end || !payload || !paylen || !protos || !codes)
+        return 1;
+
+    // Trace: receiver reset, then frames with idle gaps long enough for
+    // the beat's pseudo edge. The start is random so frames cross the
+    // 16-bit wrap of the tick counter at any point.
+    slot = cir_mode ? (double) CIR_WDT_DIV / CIR_SMCLK_FREQ : IR_SLOT_US * 1e-6;
+    t = uniform() * 65536.0 / IR_TICK_FREQ;
+    put_edge(t, IR_EDGE_RESET);
+    t += 0.01;
+    for (f = 0; f < frames; f++)
+    {
+        if (cir_mode)
+        {
+            protos[f] = f % CIR_PROTOS;
+            codes[f] = rnd() & ((1UL << (cir_protos[protos[f]].bits - 1)) * 2 - 1);
+            if (cir_protos[protos[f]].coding == CIR_BIPHASE)  // RC-5 S1 is always 1
+                codes[f] |= 1UL << (cir_protos[protos[f]].bits - 1);
+            n = encode_cir(protos[f], codes[f]);
+        }
+        else
+        {
+            paylen[f] = 1 + rnd() % IR_MAX_PAYLOAD;
+            for (i = 0; i < paylen[f]; i++)
+                payload[f][i] = rnd();
+            n = encode_packet(payload[f], paylen[f]);
+        }
+        first = nedges;
+        start = t;
+        t = transmit(t, n, slot);
+        add_noise(first, start, t, slot);
+        qsort(&edges[first], nedges - first, sizeof *edges, by_time);
+        // Quiet line: the beat pushes the current level once it has
+        // been idle for 2 * IR_MAX_SLOTS slots, to ir_push() only
+        t += 2.0 * IR_MAX_SLOTS * IR_SLOT_US * 1e-6 + 0.002;
+        if (!cir_mode)
+            put_edge(t, 1);
+        t += 0.01 + uniform() * 0.03;
+        frame_end[f] = nedges;
+    }
+
+    // Replay, one frame at a time as the target would see it
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    e = 0;
+    if (cir_mode)
+        cir_reset();
+    for (f = 0; f < frames; f++)
+    {
+        if (cir_mode)
+        {
+            want_proto = protos[f];
+            want_code = codes[f];
+        }
+        else
+        {
+            len = paylen[f];
+            memcpy(want, payload[f], len);
+            want_len = len;
+        }
+        for (; e < frame_end[f]; e++)
+        {
+            if (cir_mode)
+            {
+                if (edges[e].level != IR_EDGE_RESET)
+                    cir_edge(ticks(edges[e].t), edges[e].level);
+            }
+            else
+            {
+                ir_push(ticks(edges[e].t), edges[e].level);
+                ir_decode();
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+
+    printf("%s frames %lu good %lu bad %lu fer %.4f edges %ld %.1f ns/edge %.1f ns/frame\n",
+            cir_mode ? "cir" : (IR_CODE == IR_CODE_NRZ ? "nrz"
+                    : IR_CODE == IR_CODE_PDM ? "pdm" : "manchester"),
+            frames, good, bad, (double) (frames - (good < frames ? good : frames)) / frames,
+            nedges, ns / nedges, ns / frames);
+    return 0;
+}
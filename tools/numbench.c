@@ -0,0 +1,177 @@
+// numbench - old and new number paths of the display firmware side by
+// side on the host: the results compared over the whole input range
+// and the cost of each
+//
+// Build, the firmware modules taken as they are for the simulator;
+// TM1638.c is included below for its static ToBCD():
+//   F=../msp430-tm1638-ds18b20
+//   S="sim/stub.c $F/ds18b20.c $F/onewire.c"
+//   cc -O2 -Wall -DHAL_SIM -Isim -I$F -o numbench numbench.c $S -lm
+// Usage:  numbench [-b step]
+//
+// centi   scratchpad temperature (1/16 degC) to 1/100 degC for the
+//         display, -55 to +125 degC. Old: the float GetData() magnitude
+//         times 100, truncated. New: ds18b20_centi(), table rounded.
+// bcd     ShowDecNumber()'s binary to packed BCD, 0 to 99999999, every
+//         step-th number (1 by default). Old: % 10 and / 10 per digit.
+//         New: ToBCD(), double dabble with the portable BcdDouble() (the
+//         TI build uses DADD instead).
+// One line per path: inputs, results that differ from the exact value
+// (and for centi by how much at most) and host ns per call. The ns only rank the
+// paths on this host, which has a floating point unit and a divider.
+// The MSP430G2553 has neither: its cycle counts and code size come from
+// the BENCH build, bench.mk in the firmware directory (make -f bench.mk,
+// and its size target for the build with and without the float path).
+// The exact value is computed here, not taken from the old path: centi
+// float truncates and is one below it on 1440 of the 2881 inputs, so it
+// is no oracle for the new one.
+
+#define SIM_CORE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "ds18b20.h"
+#include "TM1638.c"
+
+#define REPEAT          200     // passes over the inputs for the timing
+
+static volatile long sink;
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, long inputs, long wrong, long worst,
+                   double ns)
+{
+    printf("%-14s inputs %9ld  off %7ld  worst ", name, inputs, wrong);
+    printf(worst < 0 ? "  -" : "%3ld", worst);
+    printf("  %7.2f ns/call\n", ns);
+}
+
+// ##### centi #####
+
+#define RAW_MIN         (-55 * 16)
+#define RAW_MAX         (125 * 16)
+
+// Old path: GetData() as a float magnitude, the sign lost, then * 100
+static long centi_float(int16_t raw)
+{
+    uint16_t temp = raw;
+    float deg;
+
+    if (temp < 0x8000)
+        deg = (temp * 0.0625);
+    else
+    {
+        temp = (~temp) + 1;
+        deg = (temp * 0.0625);
+    }
+    return deg * 100;
+}
+
+static long centi_fixed(int16_t raw)
+{
+    return ds18b20_centi(raw);
+}
+
+static void bench_centi(const char *name, long (*fn)(int16_t), int sign)
+{
+    long wrong = 0, worst = 0, d, exact;
+    double t0;
+    int raw, pass;
+
+    for (raw = RAW_MIN; raw <= RAW_MAX; raw++)
+    {
+        exact = lround(raw * 6.25);         // 1/16 degC in 1/100
+        d = labs(fn(raw) - (sign || raw >= 0 ? exact : -exact));
+        if (d)
+            wrong++;
+        if (d > worst)
+            worst = d;
+    }
+    t0 = now();
+    for (pass = 0; pass < REPEAT; pass++)
+        for (raw = RAW_MIN; raw <= RAW_MAX; raw++)
+            sink = fn(raw);
+    report(name, RAW_MAX - RAW_MIN + 1, wrong, worst,
+            (now() - t0) * 1e9 / REPEAT / (RAW_MAX - RAW_MIN + 1));
+}
+
+// ##### bcd #####
+
+#define BCD_MAX         99999999UL
+
+// Old path: ShowDecNumber() took one digit per % 10 and / 10
+static unsigned long bcd_div(unsigned long number)
+{
+    unsigned long bcd = 0;
+    unsigned int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        bcd |= (number % 10) << (4 * i);
+        number /= 10;
+    }
+    return bcd;
+}
+
+// a + b, both packed BCD: add 6 to every digit, take it back from the
+// digits that did not carry
+static uint64_t bcd_add(uint64_t a, uint64_t b)
+{
+    uint64_t t1 = a + 0x0666666666666666ULL, t2 = t1 + b;
+    uint64_t c = ~(t2 ^ t1 ^ b) & 0x1111111111111110ULL;
+
+    return t2 - ((c >> 2) | (c >> 3));
+}
+
+static void bench_bcd(const char *name, unsigned long (*fn)(unsigned long),
+                      unsigned long step)
+{
+    unsigned long n, inputs = 0;
+    uint64_t exact = 0, dstep = bcd_div(step);
+    long wrong = 0;
+    double t0;
+
+    for (n = 0; n <= BCD_MAX; n += step)
+    {
+        if (fn(n) != exact)                 // counted up in decimal
+            wrong++;
+        exact = bcd_add(exact, dstep);
+        inputs++;
+    }
+    t0 = now();
+    for (n = 0; n <= BCD_MAX; n += step)
+        sink = fn(n);
+    report(name, inputs, wrong, -1, (now() - t0) * 1e9 / inputs);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long step = 1;
+    int c;
+
+    while ((c = getopt(argc, argv, "b:")) != -1)
+    {
+        if (c != 'b' || (step = strtoul(optarg, 0, 0)) == 0)
+        {
+            fprintf(stderr, "usage: numbench [-b step]\n");
+            return 1;
+        }
+    }
+
+    // The old path returns the magnitude only, its sign is not counted
+    bench_centi("centi float", centi_float, 0);
+    bench_centi("centi fixed", centi_fixed, 1);
+    bench_bcd("bcd div", bcd_div, step);
+    bench_bcd("bcd dabble", ToBCD, step);
+    return 0;
+}
@@ -0,0 +1,430 @@
+// DS18B20s on DQ, externally powered
+//
+// Every device watches the line the way the datasheet times it: a low of
+// 480us or more is a reset, answered with a presence pulse from 30us to
+// 150us after the release; any other falling edge starts a slot. In a
+// slot the device either samples DQ 30us after the edge (master writes)
+// or, sending a 0, holds DQ low for 30us (master reads). ROM commands:
+// READ, MATCH, SKIP, SEARCH and ALARM SEARCH; function commands: CONVERT T
+// (read slots give 0 until it is done, 94..750ms by resolution), WRITE,
+// READ and COPY SCRATCHPAD (10ms EEPROM write), RECALL E2 and READ POWER
+// SUPPLY. The ROM codes are family 0x28 with the CRC of the real part.
+// With -e each bit a device sends is flipped at that rate.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+
+#define MAX_DEVS        8
+#define T_RESET         (400 * SIM_US)      // shortest low taken for a reset
+#define T_PDHIGH        (30 * SIM_US)       // release -> presence pulse
+#define T_PDLOW         (120 * SIM_US)      // presence pulse
+#define T_SAMPLE        (30 * SIM_US)       // slot start -> master bit sampled
+#define T_HOLD0         (30 * SIM_US)       // slot start -> sent 0 released
+#define T_COPY          (10 * SIM_MS)
+
+enum
+{
+    DS_IDLE,                                // not selected, waits for a reset
+    DS_ROM,                                 // ROM command
+    DS_MATCH,                               // ROM code of MATCH ROM
+    DS_SEARCH,                              // SEARCH ROM, 3 slots per bit
+    DS_FUNC,                                // function command
+    DS_WRITE,                               // TH, TL and config
+    DS_SEND,                                // bytes out, 1s after them
+    DS_BUSY                                 // 0s until busy_until, then 1s
+};
+
+typedef struct
+{
+    uint8_t rom[8], pad[9], ee[3];
+    double temp;
+    int state, alarm_search;
+    uint8_t rx[8];                          // bytes received in this state
+    int rxbits;
+    uint8_t tx[9];
+    int txbits, txlen;                      // bits sent, bits to send
+    int search_bit, search_phase;
+    uint64_t fall, quiet;                   // last slot start, edges ignored until
+    uint64_t pull_from, pull_until;         // DQ held low
+    uint64_t sample_at;                     // master bit sampled, 0 none
+    uint64_t busy_until;
+    int converting;
+    unsigned long resets, conversions, flipped;
+} ds_t;
+
+static ds_t dev[MAX_DEVS];
+static int ndev, level = 1;
+static double ramp, error_rate;
+
+static uint8_t crc8(const uint8_t *p, int n)
+{
+    uint8_t crc = 0, b;
+    int i;
+
+    while (n--)
+    {
+        b = *p++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = ((crc ^ b) & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+            b >>= 1;
+        }
+    }
+    return crc;
+}
+
+static void pad_crc(ds_t *d)
+{
+    d->pad[8] = crc8(d->pad, 8);
+}
+
+void ds_add(double temp)
+{
+    static const uint8_t serial[6] = { 0x4C, 0x72, 0x61, 0x16, 0x03, 0x00 };
+    static const uint8_t power_up[9] = {
+        0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0x1C
+    };
+    ds_t *d;
+    int i;
+
+    if (ndev == MAX_DEVS)
+        sim_fatal("at most %d sensors", MAX_DEVS);
+    d = &dev[ndev];
+    d->rom[0] = 0x28;
+    for (i = 0; i < 6; i++)
+        d->rom[1 + i] = serial[i];
+    d->rom[1] ^= ndev * 0x35;               // spread over the search tree
+    d->rom[6] += ndev;
+    d->rom[7] = crc8(d->rom, 7);
+    for (i = 0; i < 9; i++)
+        d->pad[i] = power_up[i];
+    for (i = 0; i < 3; i++)
+        d->ee[i] = power_up[2 + i];
+    d->temp = temp;
+    ndev++;
+}
+
+void ds_ramp(double deg_per_min)
+{
+    ramp = deg_per_min;
+}
+
+void ds_errors(double rate)
+{
+    error_rate = rate;
+}
+
+static double temp_now(ds_t *d)
+{
+    return d->temp + ramp * sim_ps / SIM_S / 60;
+}
+
+static int resolution(ds_t *d)
+{
+    return 9 + ((d->pad[4] >> 5) & 3);
+}
+
+static void send(ds_t *d, const uint8_t *p, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        d->tx[i] = p[i];
+    d->txbits = 0;
+    d->txlen = 8 * n;
+    d->state = DS_SEND;
+}
+
+static int alarm(ds_t *d)
+{
+    int t = (int16_t) (d->pad[0] | d->pad[1] << 8) >> 4;
+
+    return t >= (int8_t) d->pad[2] || t <= (int8_t) d->pad[3];
+}
+
+static void rom_command(ds_t *d, uint8_t cmd)
+{
+    d->rxbits = 0;
+    switch (cmd)
+    {
+    case 0x33:                              // READ ROM
+        send(d, d->rom, 8);
+        break;
+    case 0x55:                              // MATCH ROM
+        d->state = DS_MATCH;
+        break;
+    case 0xCC:                              // SKIP ROM
+        d->state = DS_FUNC;
+        break;
+    case 0xEC:                              // ALARM SEARCH
+    case 0xF0:                              // SEARCH ROM
+        d->state = cmd == 0xF0 || alarm(d) ? DS_SEARCH : DS_IDLE;
+        d->search_bit = d->search_phase = 0;
+        break;
+    default:
+        sim_log("ds18b20 %d: unknown ROM command 0x%02X", (int) (d - dev), cmd);
+        d->state = DS_IDLE;
+    }
+}
+
+static void func_command(ds_t *d, uint8_t cmd)
+{
+    int n = d - dev;
+
+    d->rxbits = 0;
+    switch (cmd)
+    {
+    case 0x44:                              // CONVERT T
+        d->busy_until = sim_ps + (uint64_t) (93.75 * SIM_MS) * (1 << (resolution(d) - 9));
+        d->converting = 1;
+        d->state = DS_BUSY;
+        sim_log("ds18b20 %d: convert, %d bits", n, resolution(d));
+        break;
+    case 0xBE:                              // READ SCRATCHPAD
+        send(d, d->pad, 9);
+        break;
+    case 0x4E:                              // WRITE SCRATCHPAD
+        d->state = DS_WRITE;
+        break;
+    case 0x48:                              // COPY SCRATCHPAD
+        d->ee[0] = d->pad[2];
+        d->ee[1] = d->pad[3];
+        d->ee[2] = d->pad[4];
+        d->busy_until = sim_ps + T_COPY;
+        d->state = DS_BUSY;
+        sim_log("ds18b20 %d: copy scratchpad, TH %d TL %d config 0x%02X",
+                n, (int8_t) d->ee[0], (int8_t) d->ee[1], d->ee[2]);
+        break;
+    case 0xB8:                              // RECALL E2
+        d->pad[2] = d->ee[0];
+        d->pad[3] = d->ee[1];
+        d->pad[4] = d->ee[2];
+        pad_crc(d);
+        d->busy_until = sim_ps;
+        d->state = DS_BUSY;
+        break;
+    case 0xB4:                              // READ POWER SUPPLY: external
+        d->busy_until = sim_ps;
+        d->state = DS_BUSY;
+        break;
+    default:
+        sim_log("ds18b20 %d: unknown function command 0x%02X", n, cmd);
+        d->state = DS_IDLE;
+    }
+}
+
+// Bit written by the master
+static void receive(ds_t *d, int bit)
+{
+    int i, n = d - dev;
+
+    if (d->state == DS_SEARCH)
+    {
+        if (bit != ((d->rom[d->search_bit >> 3] >> (d->search_bit & 7)) & 1))
+        {
+            d->state = DS_IDLE;             // took the other branch
+            return;
+        }
+        d->search_phase = 0;
+        if (++d->search_bit == 64)
+        {
+            sim_log("ds18b20 %d: found by search", n);
+            d->state = DS_FUNC;
+        }
+        return;
+    }
+    if (bit)
+        d->rx[d->rxbits >> 3] |= 1 << (d->rxbits & 7);
+    else
+        d->rx[d->rxbits >> 3] &= ~(1 << (d->rxbits & 7));
+    d->rxbits++;
+    switch (d->state)
+    {
+    case DS_ROM:
+        if (d->rxbits == 8)
+            rom_command(d, d->rx[0]);
+        break;
+    case DS_FUNC:
+        if (d->rxbits == 8)
+            func_command(d, d->rx[0]);
+        break;
+    case DS_MATCH:
+        if (d->rxbits < 64)
+            break;
+        d->rxbits = 0;
+        d->state = DS_FUNC;
+        for (i = 0; i < 8; i++)
+            if (d->rx[i] != d->rom[i])
+                d->state = DS_IDLE;
+        break;
+    case DS_WRITE:
+        if (d->rxbits < 24)
+            break;
+        d->pad[2] = d->rx[0];
+        d->pad[3] = d->rx[1];
+        d->pad[4] = (d->rx[2] & 0x60) | 0x1F;
+        pad_crc(d);
+        d->state = DS_IDLE;
+        sim_log("ds18b20 %d: scratchpad written, TH %d TL %d, %d bits",
+                n, (int8_t) d->pad[2], (int8_t) d->pad[3], resolution(d));
+        break;
+    }
+}
+
+// Bit for a read slot, 1 leaves DQ alone
+static int transmit(ds_t *d)
+{
+    int bit = 1;
+
+    switch (d->state)
+    {
+    case DS_SEND:
+        if (d->txbits < d->txlen)
+        {
+            bit = (d->tx[d->txbits >> 3] >> (d->txbits & 7)) & 1;
+            d->txbits++;
+        }
+        break;
+    case DS_BUSY:
+        bit = sim_ps >= d->busy_until;
+        break;
+    case DS_SEARCH:
+        bit = (d->rom[d->search_bit >> 3] >> (d->search_bit & 7)) & 1;
+        if (d->search_phase++)
+            bit = !bit;                     // complement
+        break;
+    }
+    if (error_rate > 0 && rand() < error_rate * RAND_MAX)
+    {
+        bit = !bit;
+        d->flipped++;
+    }
+    return bit;
+}
+
+static int sending(ds_t *d)
+{
+    return d->state == DS_SEND || d->state == DS_BUSY
+            || (d->state == DS_SEARCH && d->search_phase < 2);
+}
+
+static int receiving(ds_t *d)
+{
+    return d->state == DS_ROM || d->state == DS_MATCH || d->state == DS_FUNC
+            || d->state == DS_WRITE || (d->state == DS_SEARCH && d->search_phase == 2);
+}
+
+void ds_edge(int l)
+{
+    ds_t *d;
+    int i;
+
+    level = l;
+    for (i = 0; i < ndev; i++)
+    {
+        d = &dev[i];
+        if (sim_ps <= d->quiet)
+            continue;                       // own or other presence pulse
+        if (!l)
+        {
+            d->fall = sim_ps;
+            if (sending(d))
+            {
+                if (!transmit(d))
+                {
+                    d->pull_from = sim_ps;
+                    d->pull_until = sim_ps + T_HOLD0;
+                }
+            }
+            else if (receiving(d))
+                d->sample_at = sim_ps + T_SAMPLE;
+        }
+        else if (d->fall && sim_ps - d->fall >= T_RESET)
+        {
+            d->resets++;
+            d->state = DS_ROM;
+            d->rxbits = 0;
+            d->sample_at = 0;
+            d->pull_from = sim_ps + T_PDHIGH;
+            d->pull_until = d->quiet = d->pull_from + T_PDLOW;
+        }
+    }
+}
+
+int ds_pulling(void)
+{
+    int i;
+
+    for (i = 0; i < ndev; i++)
+        if (dev[i].pull_from <= sim_ps && sim_ps < dev[i].pull_until)
+            return 1;
+    return 0;
+}
+
+uint64_t ds_next(void)
+{
+    uint64_t e = SIM_NEVER;
+    ds_t *d;
+    int i;
+
+    for (i = 0; i < ndev; i++)
+    {
+        d = &dev[i];
+        if (d->pull_from > sim_ps && d->pull_from < e)
+            e = d->pull_from;
+        if (d->pull_until > sim_ps && d->pull_until < e)
+            e = d->pull_until;
+        if (d->sample_at && d->sample_at < e)
+            e = d->sample_at;
+        if (d->converting && d->busy_until < e)
+            e = d->busy_until;
+    }
+    return e;
+}
+
+void ds_sync(void)
+{
+    ds_t *d;
+    int i, raw;
+
+    for (i = 0; i < ndev; i++)
+    {
+        d = &dev[i];
+        if (d->sample_at && d->sample_at <= sim_ps)
+        {
+            d->sample_at = 0;
+            receive(d, level);
+        }
+        if (d->converting && d->busy_until <= sim_ps)
+        {
+            d->converting = 0;
+            d->conversions++;
+            raw = (int) lround(temp_now(d) * 16);
+            if (raw > 125 * 16)
+                raw = 125 * 16;
+            if (raw < -55 * 16)
+                raw = -55 * 16;
+            raw &= ~((1 << (12 - resolution(d))) - 1);
+            d->pad[0] = raw & 0xFF;
+            d->pad[1] = (raw >> 8) & 0xFF;
+            pad_crc(d);
+        }
+    }
+}
+
+void ds_report(void)
+{
+    int i, j;
+
+    for (i = 0; i < ndev; i++)
+    {
+        printf("ds18b20 %d: ROM", i);
+        for (j = 0; j < 8; j++)
+            printf(" %02X", dev[i].rom[j]);
+        printf(", %.2f degC, %d bits, %lu resets, %lu conversions, %lu bits flipped\n",
+                temp_now(&dev[i]), resolution(&dev[i]), dev[i].resets,
+                dev[i].conversions, dev[i].flipped);
+    }
+}
@@ -0,0 +1,273 @@
+#ifndef MSP430SIM_H_
+#define MSP430SIM_H_
+
+// ##################### Host register model ######################
+// Stands in for msp430g2553.h when the firmware is built with HAL_SIM,
+// see sim.c for the build. Each register is a call into the simulator:
+// it brings the peripheral models up to the virtual time of the access
+// and takes pending interrupts before it hands the register out, so
+// polling loops and sleeps see time pass. A write is applied when the
+// firmware calls into the simulator the next time. Bit names carry the
+// values of the device header, the intrinsics are simulator functions
+// and the firmware's main() becomes fw_main(), called by the simulator.
+
+#include <stdint.h>
+
+#if defined(OW_UART) && OW_UART || defined(TRACE) && TRACE || defined(BENCH) && BENCH
+#error "HAL_SIM: no models for OW_UART, TRACE or BENCH"
+#endif
+
+#ifndef SIM_CORE
+#define main fw_main
+#endif
+
+enum
+{
+    // byte registers
+    SIM_P1IN, SIM_P1OUT, SIM_P1DIR, SIM_P1SEL, SIM_P1SEL2, SIM_P1REN,
+    SIM_P2IN, SIM_P2OUT, SIM_P2DIR, SIM_P2SEL, SIM_P2SEL2, SIM_P2REN,
+    SIM_IE2, SIM_IFG2, SIM_BCSCTL1, SIM_BCSCTL2, SIM_DCOCTL,
+    SIM_UCA0CTL0, SIM_UCA0CTL1, SIM_UCA0BR0, SIM_UCA0BR1, SIM_UCA0MCTL,
+    SIM_UCA0STAT, SIM_UCA0RXBUF, SIM_UCA0TXBUF,
+    // word registers
+    SIM_WDTCTL,
+    SIM_TA0CTL, SIM_TA0R, SIM_TA0CCTL0, SIM_TA0CCTL1, SIM_TA0CCTL2,
+    SIM_TA0CCR0, SIM_TA0CCR1, SIM_TA0CCR2, SIM_TA0IV,
+    SIM_TA1CTL, SIM_TA1R, SIM_TA1CCTL0, SIM_TA1CCTL1, SIM_TA1CCTL2,
+    SIM_TA1CCR0, SIM_TA1CCR1, SIM_TA1CCR2, SIM_TA1IV,
+    SIM_FCTL1, SIM_FCTL2, SIM_FCTL3,
+    SIM_REGS
+};
+
+volatile uint8_t *sim_reg8(int id);
+volatile uint16_t *sim_reg16(int id);
+
+#define P1IN        (*sim_reg8(SIM_P1IN))
+#define P1OUT       (*sim_reg8(SIM_P1OUT))
+#define P1DIR       (*sim_reg8(SIM_P1DIR))
+#define P1SEL       (*sim_reg8(SIM_P1SEL))
+#define P1SEL2      (*sim_reg8(SIM_P1SEL2))
+#define P1REN       (*sim_reg8(SIM_P1REN))
+#define P2IN        (*sim_reg8(SIM_P2IN))
+#define P2OUT       (*sim_reg8(SIM_P2OUT))
+#define P2DIR       (*sim_reg8(SIM_P2DIR))
+#define P2SEL       (*sim_reg8(SIM_P2SEL))
+#define P2SEL2      (*sim_reg8(SIM_P2SEL2))
+#define P2REN       (*sim_reg8(SIM_P2REN))
+#define IE2         (*sim_reg8(SIM_IE2))
+#define IFG2        (*sim_reg8(SIM_IFG2))
+#define BCSCTL1     (*sim_reg8(SIM_BCSCTL1))
+#define BCSCTL2     (*sim_reg8(SIM_BCSCTL2))
+#define DCOCTL      (*sim_reg8(SIM_DCOCTL))
+#define UCA0CTL0    (*sim_reg8(SIM_UCA0CTL0))
+#define UCA0CTL1    (*sim_reg8(SIM_UCA0CTL1))
+#define UCA0BR0     (*sim_reg8(SIM_UCA0BR0))
+#define UCA0BR1     (*sim_reg8(SIM_UCA0BR1))
+#define UCA0MCTL    (*sim_reg8(SIM_UCA0MCTL))
+#define UCA0STAT    (*sim_reg8(SIM_UCA0STAT))
+#define UCA0RXBUF   (*sim_reg8(SIM_UCA0RXBUF))
+#define UCA0TXBUF   (*sim_reg8(SIM_UCA0TXBUF))
+#define WDTCTL      (*sim_reg16(SIM_WDTCTL))
+#define TACTL       (*sim_reg16(SIM_TA0CTL))
+#define TAR         (*sim_reg16(SIM_TA0R))
+#define TACCTL0     (*sim_reg16(SIM_TA0CCTL0))
+#define TACCTL1     (*sim_reg16(SIM_TA0CCTL1))
+#define TACCTL2     (*sim_reg16(SIM_TA0CCTL2))
+#define TACCR0      (*sim_reg16(SIM_TA0CCR0))
+#define TACCR1      (*sim_reg16(SIM_TA0CCR1))
+#define TACCR2      (*sim_reg16(SIM_TA0CCR2))
+#define TA0IV       (*sim_reg16(SIM_TA0IV))
+#define TA1CTL      (*sim_reg16(SIM_TA1CTL))
+#define TA1R        (*sim_reg16(SIM_TA1R))
+#define TA1CCTL0    (*sim_reg16(SIM_TA1CCTL0))
+#define TA1CCTL1    (*sim_reg16(SIM_TA1CCTL1))
+#define TA1CCTL2    (*sim_reg16(SIM_TA1CCTL2))
+#define TA1CCR0     (*sim_reg16(SIM_TA1CCR0))
+#define TA1CCR1     (*sim_reg16(SIM_TA1CCR1))
+#define TA1CCR2     (*sim_reg16(SIM_TA1CCR2))
+#define TA1IV       (*sim_reg16(SIM_TA1IV))
+#define FCTL1       (*sim_reg16(SIM_FCTL1))
+#define FCTL2       (*sim_reg16(SIM_FCTL2))
+#define FCTL3       (*sim_reg16(SIM_FCTL3))
+
+// Info memory 0x1000-0x10FF, segment A holds the DCO calibration
+extern uint8_t sim_info[256];
+#define SIM_INFO_MEM    sim_info
+#define CALDCO_16MHZ    (sim_info[0xF8])
+#define CALBC1_16MHZ    (sim_info[0xF9])
+#define CALDCO_12MHZ    (sim_info[0xFA])
+#define CALBC1_12MHZ    (sim_info[0xFB])
+#define CALDCO_8MHZ     (sim_info[0xFC])
+#define CALBC1_8MHZ     (sim_info[0xFD])
+#define CALDCO_1MHZ     (sim_info[0xFE])
+#define CALBC1_1MHZ     (sim_info[0xFF])
+
+// ##### Intrinsics #####
+unsigned short __get_interrupt_state(void);
+void __set_interrupt_state(unsigned short sr);
+void __disable_interrupt(void);
+void __enable_interrupt(void);
+void __bis_SR_register(unsigned short bits);
+void __bic_SR_register_on_exit(unsigned short bits);
+void __delay_cycles(unsigned long cycles);
+void __no_operation(void);
+
+// Interrupt service routine, registered with the simulator before main
+void sim_vector(unsigned int vec, void (*isr)(void));
+#define SIM_ISR(vec, name) \
+    static void name(void); \
+    static void __attribute__((constructor)) name##_vector(void) \
+    { sim_vector((vec), name); } \
+    static void name(void)
+
+// ##### Status register #####
+#define GIE         0x0008
+#define CPUOFF      0x0010
+#define OSCOFF      0x0020
+#define SCG0        0x0040
+#define SCG1        0x0080
+#define LPM0_bits   (CPUOFF)
+#define LPM1_bits   (SCG0 + CPUOFF)
+#define LPM2_bits   (SCG1 + CPUOFF)
+#define LPM3_bits   (SCG1 + SCG0 + CPUOFF)
+#define LPM4_bits   (SCG1 + SCG0 + OSCOFF + CPUOFF)
+
+#define BIT0        0x0001
+#define BIT1        0x0002
+#define BIT2        0x0004
+#define BIT3        0x0008
+#define BIT4        0x0010
+#define BIT5        0x0020
+#define BIT6        0x0040
+#define BIT7        0x0080
+
+// ##### Vectors, the higher number wins #####
+#define PORT1_VECTOR        (2 * 1u)
+#define PORT2_VECTOR        (3 * 1u)
+#define ADC10_VECTOR        (5 * 1u)
+#define USCIAB0TX_VECTOR    (6 * 1u)
+#define USCIAB0RX_VECTOR    (7 * 1u)
+#define TIMER0_A1_VECTOR    (8 * 1u)
+#define TIMER0_A0_VECTOR    (9 * 1u)
+#define WDT_VECTOR          (10 * 1u)
+#define COMPARATORA_VECTOR  (11 * 1u)
+#define TIMER1_A1_VECTOR    (12 * 1u)
+#define TIMER1_A0_VECTOR    (13 * 1u)
+#define NMI_VECTOR          (14 * 1u)
+
+// ##### Basic clock system #####
+#define XT2OFF      0x80
+#define XTS         0x40
+#define DIVA_0      0x00
+#define DIVA_1      0x10
+#define DIVA_2      0x20
+#define DIVA_3      0x30
+#define SELM_0      0x00
+#define DIVM_0      0x00
+#define DIVM_1      0x10
+#define DIVM_2      0x20
+#define DIVM_3      0x30
+#define SELS        0x08
+#define DIVS_0      0x00
+#define DIVS_1      0x02
+#define DIVS_2      0x04
+#define DIVS_3      0x06
+
+// ##### Watchdog #####
+#define WDTPW       0x5A00
+#define WDTHOLD     0x0080
+#define WDTCNTCL    0x0008
+
+// ##### Timer_A #####
+#define TASSEL_0    0x0000
+#define TASSEL_1    0x0100
+#define TASSEL_2    0x0200
+#define TASSEL_3    0x0300
+#define ID_0        0x0000
+#define ID_1        0x0040
+#define ID_2        0x0080
+#define ID_3        0x00C0
+#define MC_0        0x0000
+#define MC_1        0x0010
+#define MC_2        0x0020
+#define MC_3        0x0030
+#define TACLR       0x0004
+#define TAIE        0x0002
+#define TAIFG       0x0001
+#define CM_0        0x0000
+#define CM_1        0x4000
+#define CM_2        0x8000
+#define CM_3        0xC000
+#define CCIS_0      0x0000
+#define CCIS_1      0x1000
+#define CCIS_2      0x2000
+#define CCIS_3      0x3000
+#define SCS         0x0800
+#define SCCI        0x0400
+#define CAP         0x0100
+#define OUTMOD_0    0x0000
+#define OUTMOD_1    0x0020
+#define OUTMOD_2    0x0040
+#define OUTMOD_3    0x0060
+#define OUTMOD_4    0x0080
+#define OUTMOD_5    0x00A0
+#define OUTMOD_6    0x00C0
+#define OUTMOD_7    0x00E0
+#define CCIE        0x0010
+#define CCI         0x0008
+#define OUT         0x0004
+#define COV         0x0002
+#define CCIFG       0x0001
+#define TA0IV_NONE      0x0000
+#define TA0IV_TACCR1    0x0002
+#define TA0IV_TACCR2    0x0004
+#define TA0IV_TAIFG     0x000A
+#define TA1IV_NONE      0x0000
+#define TA1IV_TACCR1    0x0002
+#define TA1IV_TACCR2    0x0004
+#define TA1IV_TAIFG     0x000A
+
+// ##### USCI_A0, SPI and UART #####
+#define UCCKPH      0x80
+#define UCCKPL      0x40
+#define UCMSB       0x20
+#define UC7BIT      0x10
+#define UCMST       0x08
+#define UCMODE_0    0x00
+#define UCSYNC      0x01
+#define UCSSEL_0    0x00
+#define UCSSEL_1    0x40
+#define UCSSEL_2    0x80
+#define UCSSEL_3    0xC0
+#define UCSWRST     0x01
+#define UCLISTEN    0x80
+#define UCFE        0x40
+#define UCOE        0x20
+#define UCBUSY      0x01
+#define UCA0RXIE    0x01
+#define UCA0TXIE    0x02
+#define UCA0RXIFG   0x01
+#define UCA0TXIFG   0x02
+
+// ##### Flash controller #####
+#define FRKEY       0x9600
+#define FWKEY       0xA500
+#define ERASE       0x0002
+#define MERAS       0x0004
+#define WRT         0x0040
+#define BLKWRT      0x0080
+#define FN0         0x0001
+#define FSSEL_0     0x0000
+#define FSSEL_1     0x0040
+#define FSSEL_2     0x0080
+#define FSSEL_3     0x00C0
+#define BUSY        0x0001
+#define KEYV        0x0002
+#define ACCVIFG     0x0004
+#define WAIT        0x0008
+#define LOCK        0x0010
+#define EMEX        0x0020
+#define LOCKA       0x0040
+#define FAIL        0x0080
+
+#endif /* MSP430SIM_H_ */
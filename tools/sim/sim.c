@@ -0,0 +1,1025 @@
+// sim: run msp430-tm1638-ds18b20 on the host
+//
+// The firmware is compiled for the host with HAL_SIM (hal.h then takes
+// msp430sim.h instead of the device header) and linked with this
+// simulator: register models of the MSP430G2553 parts it uses (basic
+// clock system, Timer0_A, Timer1_A, USCI_A0 as SPI master, P1 and P2,
+// flash controller and info memory) and models of the board, a TM1638
+// LED&KEY module on the SPI (tm1638_model.c) and DS18B20s on the 1-Wire
+// pin P2.3 (ds18b20_model.c). The wiring is the one of hal.h without
+// OW_UART.
+//
+// Virtual time is in ps. Every register access and intrinsic costs
+// ACCESS_CYCLES MCLK cycles, __delay_cycles() and sleeps take their real
+// time and the C code in between is free, so ISR and slot timing come
+// out a little short. The timers count every ACLK and SMCLK edge, SMCLK
+// stops in LPM3. Whenever the display settles on new content it is
+// printed with the time; key presses, sensor temperatures and bit errors
+// on the bus are set on the command line.
+//
+// Build from the top of the tree:
+//   F=msp430-tm1638-ds18b20; S="tools/sim/sim.c tools/sim/*_model.c"
+//   cc -O2 -Wall -Wno-return-type -DHAL_SIM -Itools/sim -I$F -o sim $S $F/*.c -lm
+// (main() becomes fw_main(), which never returns)
+// then e.g. 30 s with two sensors, KEY2 (temperature view) pressed at 5 s:
+//   ./sim -s 30 -t 21.5 -t -3.25 -k 5:2
+
+#define SIM_CORE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "msp430sim.h"
+#include "sim.h"
+
+#define ACCESS_CYCLES   4       // MCLK cycles per register access or intrinsic
+#define ISR_ENTRY       6       // MCLK cycles to enter an ISR
+#define ISR_EXIT        5       // RETI
+#define SETTLE          (20 * SIM_MS)   // display unchanged that long is printed
+#define MAX_KEYS        32
+
+#define FLASH_ERASE     4819    // flash timing generator cycles, segment erase
+#define FLASH_BYTE      30      // byte program
+
+int fw_main(void);
+
+uint64_t sim_ps;
+int sim_verbose;
+uint8_t sim_info[256];
+
+static uint16_t reg[SIM_REGS];
+static int pending = -1;                    // register handed out last
+static uint16_t pending_val;                // its value then
+static unsigned int sr;
+static unsigned int *exit_sr;               // SR the running ISR returns to
+static void (*vector[16])(void);
+static unsigned long isr_count[16];
+static uint64_t end_ps = 10 * SIM_S;
+static int quiet;
+static const char *info_file;
+
+static void models_sync(void);
+static void advance_to(uint64_t target);
+static void pins_update(void);
+
+// ##################### Log ###############################
+
+static void stamp(FILE *f)
+{
+    fprintf(f, "%12.6f  ", (double) sim_ps / SIM_S);
+}
+
+void sim_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (!sim_verbose)
+        return;
+    stamp(stderr);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+void sim_fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    stamp(stderr);
+    fputs("sim: ", stderr);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    exit(2);
+}
+
+// ##################### Clocks ############################
+// DCO from the calibration pairs in info A, ~1.1MHz otherwise. MCLK and
+// SMCLK both run from it, ACLK is the 32768Hz crystal.
+
+static const struct
+{
+    uint8_t bc1, dco;
+    uint32_t hz;
+} dco_cal[] = {
+    { 0x86, 0xB9, 1000000 }, { 0x8D, 0x92, 8000000 },
+    { 0x8E, 0x9E, 12000000 }, { 0x8F, 0x95, 16000000 }
+};
+
+static uint64_t dco_ps = SIM_S / 1100000;
+static uint64_t sm_base_n, sm_base_ps, sm_period;
+static int sm_on;
+
+static void dco_update(void)
+{
+    unsigned int i;
+
+    dco_ps = SIM_S / 1100000;
+    for (i = 0; i < sizeof dco_cal / sizeof dco_cal[0]; i++)
+        if ((reg[SIM_BCSCTL1] & 0x0F) == (dco_cal[i].bc1 & 0x0F)
+                && reg[SIM_DCOCTL] == dco_cal[i].dco)
+            dco_ps = SIM_S / dco_cal[i].hz;
+}
+
+static uint64_t mclk_ps(void)
+{
+    return dco_ps << ((reg[SIM_BCSCTL2] >> 4) & 3);
+}
+
+static uint64_t smclk_n(void)
+{
+    if (!sm_on)
+        return sm_base_n;
+    return sm_base_n + (sim_ps - sm_base_ps) / sm_period;
+}
+
+static uint64_t smclk_at(uint64_t n)
+{
+    if (!sm_on)
+        return SIM_NEVER;
+    return sm_base_ps + (n - sm_base_n) * sm_period;
+}
+
+// Count the edges so far at the old rate, then go on at the new one
+static void smclk_update(void)
+{
+    sm_base_n = smclk_n();
+    sm_base_ps = sim_ps;
+    sm_period = dco_ps << ((reg[SIM_BCSCTL2] >> 1) & 3);
+    sm_on = !(sr & SCG1);
+}
+
+static uint64_t aclk_n(void)
+{
+    return (uint64_t) ((unsigned __int128) sim_ps * 32768 / SIM_S);
+}
+
+static uint64_t aclk_at(uint64_t n)
+{
+    return (uint64_t) (((unsigned __int128) n * SIM_S + 32767) / 32768);
+}
+
+// ##################### Timer_A ###########################
+
+typedef struct
+{
+    const char *name;
+    int ctl, r, cctl, ccr;                  // register ids, CCRn at cctl + n
+    uint64_t last;                          // source edges counted
+    int out[3];                             // output latches
+} timer_a_t;
+
+static timer_a_t ta[2] = {
+    { "Timer0_A", SIM_TA0CTL, SIM_TA0R, SIM_TA0CCTL0, SIM_TA0CCR0, 0, { 0 } },
+    { "Timer1_A", SIM_TA1CTL, SIM_TA1R, SIM_TA1CCTL0, SIM_TA1CCR0, 0, { 0 } }
+};
+static int dq_level = 1;
+
+static uint64_t timer_src_n(timer_a_t *t)
+{
+    switch (reg[t->ctl] & TASSEL_3)
+    {
+    case TASSEL_1:
+        return aclk_n();
+    case TASSEL_2:
+        return smclk_n();
+    }
+    return t->last;                         // TACLK, INCLK: not wired
+}
+
+static uint64_t timer_src_at(timer_a_t *t, uint64_t n)
+{
+    switch (reg[t->ctl] & TASSEL_3)
+    {
+    case TASSEL_1:
+        return aclk_at(n);
+    case TASSEL_2:
+        return smclk_at(n);
+    }
+    return SIM_NEVER;
+}
+
+static uint32_t timer_period(timer_a_t *t)
+{
+    switch (reg[t->ctl] & MC_3)
+    {
+    case MC_1:
+        return reg[t->ccr] + 1u;
+    case MC_2:
+        return 0x10000;
+    case MC_3:
+        sim_fatal("%s: up/down mode not modelled", t->name);
+    }
+    return 0;
+}
+
+// Source edges until the next compare or wrap, 0 when stopped
+static uint32_t timer_dist(timer_a_t *t)
+{
+    uint32_t p = timer_period(t), r = reg[t->r], best, d, c;
+    int n;
+
+    if (!p)
+        return 0;
+    if (r >= p)
+        return 1;                           // CCR0 moved below TAR: rolls to 0
+    best = p - r;
+    for (n = 0; n < 3; n++)
+    {
+        c = reg[t->ccr + n];
+        if (c >= p)
+            continue;
+        d = (c + p - r) % p;
+        if (!d)
+            d = p;
+        if (d < best)
+            best = d;
+    }
+    return best;
+}
+
+static void timer_compare(timer_a_t *t, int n)
+{
+    uint16_t *cctl = &reg[t->cctl + n];
+
+    if (*cctl & CAP)
+        sim_fatal("%s: capture mode not modelled", t->name);
+    *cctl |= CCIFG;
+    if ((*cctl & CCIS_3) == CCIS_1 && t == &ta[1] && n == 0)
+    { // CCI0B is P2.3, DQ
+        if (dq_level)
+            *cctl |= SCCI;
+        else
+            *cctl &= ~SCCI;
+    }
+    switch (*cctl & OUTMOD_7)
+    {
+    case OUTMOD_0:
+        break;
+    case OUTMOD_1:
+        t->out[n] = 1;
+        break;
+    case OUTMOD_4:
+        t->out[n] ^= 1;
+        break;
+    case OUTMOD_5:
+        t->out[n] = 0;
+        break;
+    default:
+        sim_fatal("%s: OUTMOD %d not modelled", t->name, (*cctl >> 5) & 7);
+    }
+}
+
+static void timer_sync(timer_a_t *t)
+{
+    uint64_t now = timer_src_n(t), n = now - t->last;
+    uint32_t d, p, r;
+    int i;
+
+    t->last = now;
+    while (n && (d = timer_dist(t)) != 0)
+    {
+        p = timer_period(t);
+        r = reg[t->r];
+        if (n < d)
+        {
+            reg[t->r] = r + n;
+            break;
+        }
+        n -= d;
+        r = r >= p ? 0 : (r + d) % p;
+        reg[t->r] = r;
+        if (!r)
+            reg[t->ctl] |= TAIFG;
+        for (i = 0; i < 3; i++)
+            if (reg[t->ccr + i] == r && r < p)
+                timer_compare(t, i);
+    }
+    for (i = 0; i < 3; i++)
+        if ((reg[t->cctl + i] & OUTMOD_7) == OUTMOD_0)
+            t->out[i] = (reg[t->cctl + i] & OUT) != 0;
+}
+
+static uint64_t timer_next(timer_a_t *t)
+{
+    uint32_t d = timer_dist(t);
+
+    return d ? timer_src_at(t, t->last + d) : SIM_NEVER;
+}
+
+// TAxIV: highest enabled flag, reading clears it
+static uint16_t timer_iv(timer_a_t *t)
+{
+    int n;
+
+    for (n = 1; n < 3; n++)
+        if ((reg[t->cctl + n] & (CCIE | CCIFG)) == (CCIE | CCIFG))
+        {
+            reg[t->cctl + n] &= ~CCIFG;
+            return n * 2;
+        }
+    if ((reg[t->ctl] & (TAIE | TAIFG)) == (TAIE | TAIFG))
+    {
+        reg[t->ctl] &= ~TAIFG;
+        return 10;
+    }
+    return 0;
+}
+
+static int timer_irq(timer_a_t *t)
+{
+    int n;
+
+    for (n = 1; n < 3; n++)
+        if ((reg[t->cctl + n] & (CCIE | CCIFG)) == (CCIE | CCIFG))
+            return 1;
+    return (reg[t->ctl] & (TAIE | TAIFG)) == (TAIE | TAIFG);
+}
+
+// ##################### USCI_A0, SPI master ###############
+// TXBUF goes into the shift register as soon as it is free, 8 bit clocks
+// of SMCLK / UCBRx later the byte is out and RXBUF holds what came back
+// on DIO: the TM1638 pulls it low for 0 bits of a key scan.
+
+static struct
+{
+    int full, busy;
+    uint8_t txbuf, shift;
+    uint64_t end;                           // SMCLK edge the byte is out
+    unsigned long bytes, overruns;
+} spi;
+
+static void spi_load(uint64_t from)
+{
+    unsigned int br = reg[SIM_UCA0BR0] | reg[SIM_UCA0BR1] << 8;
+
+    if ((reg[SIM_UCA0CTL1] & UCSSEL_3) < UCSSEL_2)
+        sim_fatal("USCI_A0: only SMCLK is modelled");
+    spi.busy = 1;
+    spi.shift = spi.txbuf;
+    spi.full = 0;
+    spi.end = from + 8 * (br ? br : 1);
+    reg[SIM_IFG2] |= UCA0TXIFG;
+}
+
+static void spi_tx(uint8_t v)
+{
+    if (reg[SIM_UCA0CTL1] & UCSWRST)
+        return;
+    if (spi.full)
+        spi.overruns++;                     // TXBUF written while full
+    spi.txbuf = v;
+    spi.full = 1;
+    reg[SIM_IFG2] &= ~UCA0TXIFG;
+    if (!spi.busy)
+        spi_load(smclk_n());
+}
+
+static void spi_reset(void)
+{
+    spi.full = spi.busy = 0;
+    reg[SIM_IFG2] = (reg[SIM_IFG2] & ~UCA0RXIFG) | UCA0TXIFG;
+    reg[SIM_IE2] &= ~(UCA0RXIE | UCA0TXIE);
+}
+
+static void spi_sync(void)
+{
+    uint64_t end;
+
+    while (spi.busy && smclk_n() >= spi.end)
+    {
+        if (reg[SIM_IFG2] & UCA0RXIFG)
+            reg[SIM_UCA0STAT] |= UCOE;
+        reg[SIM_UCA0RXBUF] = spi.shift & tm_byte(spi.shift);
+        reg[SIM_IFG2] |= UCA0RXIFG;
+        spi.busy = 0;
+        spi.bytes++;
+        end = spi.end;
+        if (spi.full)
+            spi_load(end);
+    }
+}
+
+static uint64_t spi_next(void)
+{
+    return spi.busy ? smclk_at(spi.end) : SIM_NEVER;
+}
+
+// ##################### Flash ############################
+// The firmware writes info memory through plain pointers. Each time it
+// calls into the simulator the info memory is compared with a shadow
+// copy and the changes are checked against the controller state: a
+// write in ERASE mode erases the segment, in WRT mode bits can only be
+// cleared, anything else is an access violation and is undone. The CPU
+// is held for the programming time. A dummy write of the value already
+// there is not seen.
+
+static uint8_t shadow[256];
+static unsigned long flash_erases, flash_bytes, flash_violations;
+
+static void flash_busy(unsigned long cycles)
+{
+    uint64_t ps;
+    unsigned int fn = (reg[SIM_FCTL2] & 0x3F) + 1;
+
+    switch (reg[SIM_FCTL2] & FSSEL_3)
+    {
+    case FSSEL_0:
+        ps = SIM_S / 32768;
+        break;
+    case FSSEL_1:
+        ps = mclk_ps();
+        break;
+    default:
+        ps = dco_ps << ((reg[SIM_BCSCTL2] >> 1) & 3);
+        break;
+    }
+    ps *= fn;
+    if (ps < SIM_S / 476000 || ps > SIM_S / 257000)
+        sim_fatal("flash timing generator at %.0f kHz, 257-476 kHz allowed",
+                (double) SIM_S / ps / 1000);
+    advance_to(sim_ps + cycles * ps);       // CPU held, the peripherals run on
+}
+
+static void flash_check(void)
+{
+    unsigned int mode, i, seg;
+
+    if (!memcmp(shadow, sim_info, sizeof shadow))
+        return;
+    mode = reg[SIM_FCTL1] & (ERASE | MERAS | WRT | BLKWRT);
+    for (i = 0; i < sizeof shadow; i++)
+    {
+        if (sim_info[i] == shadow[i])
+            continue;
+        seg = i / 64;
+        if ((reg[SIM_FCTL3] & LOCK) || !mode
+                || (seg == 3 && (reg[SIM_FCTL3] & LOCKA)))
+        {
+            stamp(stderr);
+            fprintf(stderr, "sim: flash write 0x%02X to 0x%04X ignored, %s\n",
+                    sim_info[i], 0x1000 + i, (reg[SIM_FCTL3] & LOCK) ? "LOCK set"
+                    : !mode ? "no ERASE/WRT" : "LOCKA set");
+            sim_info[i] = shadow[i];
+            reg[SIM_FCTL3] |= ACCVIFG;
+            flash_violations++;
+        }
+        else if (mode & (ERASE | MERAS))
+        {
+            sim_log("flash: erase segment %c", "DCBA"[seg]);
+            memset(&shadow[seg * 64], 0xFF, 64);
+            memcpy(&sim_info[seg * 64], &shadow[seg * 64], 64);
+            flash_erases++;
+            flash_busy(FLASH_ERASE);
+        }
+        else
+        {
+            shadow[i] &= sim_info[i];
+            sim_info[i] = shadow[i];
+            flash_bytes++;
+            flash_busy(FLASH_BYTE);
+        }
+    }
+}
+
+static void info_load(void)
+{
+    FILE *f;
+    unsigned int i;
+
+    memset(sim_info, 0xFF, sizeof sim_info);
+    for (i = 0; i < sizeof dco_cal / sizeof dco_cal[0]; i++)
+    {
+        sim_info[0xFE - 2 * i] = dco_cal[i].dco;
+        sim_info[0xFF - 2 * i] = dco_cal[i].bc1;
+    }
+    if (info_file && (f = fopen(info_file, "rb")) != NULL)
+    {
+        if (fread(sim_info, 1, sizeof sim_info, f) != sizeof sim_info)
+            sim_fatal("%s: not a 256 byte info memory image", info_file);
+        fclose(f);
+    }
+    memcpy(shadow, sim_info, sizeof shadow);
+}
+
+static void info_save(void)
+{
+    FILE *f;
+
+    if (!info_file)
+        return;
+    f = fopen(info_file, "wb");
+    if (!f || fwrite(sim_info, 1, sizeof sim_info, f) != sizeof sim_info)
+        sim_fatal("%s: cannot write", info_file);
+    fclose(f);
+}
+
+// ##################### Pins ##############################
+// P1.5 STROBE (pulled up on the module), P2.3 DQ: TA1.0 output while
+// P2SEL is set, else P2OUT, released when P2DIR is clear. Every device
+// can pull it low.
+
+static int strobe_level = 1;
+
+static void pins_update(void)
+{
+    int level, i;
+
+    level = (reg[SIM_P1DIR] & BIT5) ? (reg[SIM_P1OUT] & BIT5) != 0 : 1;
+    if (level != strobe_level)
+    {
+        strobe_level = level;
+        tm_strobe(level);
+    }
+    for (i = 0; i < 4; i++)                 // a device may answer an edge at once
+    {
+        if (!(reg[SIM_P2DIR] & BIT3))
+            level = 1;
+        else if (reg[SIM_P2SEL] & BIT3)
+            level = ta[1].out[0];
+        else
+            level = (reg[SIM_P2OUT] & BIT3) != 0;
+        level = level && !ds_pulling();
+        if (level == dq_level)
+            break;
+        dq_level = level;
+        ds_edge(level);
+    }
+}
+
+// ##################### Keys and display ##################
+
+static struct
+{
+    uint64_t at;
+    int key, down;
+} keys[2 * MAX_KEYS];
+static int nkeys, key_next;
+static uint64_t print_at = SIM_NEVER;
+static char shown[64];
+
+static void keys_sync(void)
+{
+    while (key_next < nkeys && keys[key_next].at <= sim_ps)
+    {
+        sim_log("key %d %s", keys[key_next].key, keys[key_next].down ? "down" : "up");
+        tm_key(keys[key_next].key, keys[key_next].down);
+        key_next++;
+    }
+}
+
+static void display_sync(void)
+{
+    char text[64];
+
+    if (tm_changed())
+        print_at = sim_ps + SETTLE;
+    if (sim_ps < print_at)
+        return;
+    print_at = SIM_NEVER;
+    tm_text(text);
+    if (!quiet && strcmp(text, shown))
+    {
+        stamp(stdout);
+        printf("%s\n", text);
+        fflush(stdout);
+    }
+    strcpy(shown, text);
+}
+
+// ##################### Time ##############################
+
+static void finish(void)
+{
+    static const char *const name[16] = {
+        [6] = "USCIAB0TX", [7] = "USCIAB0RX", [8] = "Timer0_A1",
+        [9] = "Timer0_A0", [12] = "Timer1_A1", [13] = "Timer1_A0"
+    };
+    char text[64];
+    int i;
+
+    tm_text(text);
+    stamp(stdout);
+    printf("%s  end\n", text);
+    printf("interrupts:");
+    for (i = 15; i >= 0; i--)
+        if (isr_count[i])
+            printf(" %s %lu", name[i] ? name[i] : "?", isr_count[i]);
+    printf("\nspi: %lu bytes, %lu TXBUF overruns\n", spi.bytes, spi.overruns);
+    tm_report();
+    ds_report();
+    printf("flash: %lu segment erases, %lu bytes written, %lu violations\n",
+            flash_erases, flash_bytes, flash_violations);
+    info_save();
+    exit(0);
+}
+
+static void models_sync(void)
+{
+    timer_sync(&ta[0]);
+    timer_sync(&ta[1]);
+    spi_sync();
+    ds_sync();
+    pins_update();
+    keys_sync();
+    display_sync();
+    if (sim_ps >= end_ps)
+        finish();
+}
+
+static uint64_t next_event(void)
+{
+    uint64_t e = end_ps, n;
+
+    if ((n = timer_next(&ta[0])) < e)
+        e = n;
+    if ((n = timer_next(&ta[1])) < e)
+        e = n;
+    if ((n = spi_next()) < e)
+        e = n;
+    if ((n = ds_next()) < e)
+        e = n;
+    if (key_next < nkeys && keys[key_next].at < e)
+        e = keys[key_next].at;
+    if (print_at < e)
+        e = print_at;
+    return e;
+}
+
+static void advance_to(uint64_t target)
+{
+    uint64_t e;
+
+    while ((e = next_event()) <= target)
+    {
+        sim_ps = e;
+        models_sync();
+    }
+    sim_ps = target;
+    models_sync();
+}
+
+static void cycles(unsigned long n)
+{
+    advance_to(sim_ps + n * mclk_ps());
+}
+
+// ##################### CPU ###############################
+
+static void set_sr(unsigned int v)
+{
+    if ((v ^ sr) & SCG1)
+    {
+        models_sync();
+        sr = v;
+        smclk_update();
+    }
+    else
+        sr = v;
+}
+
+static int irq(void)
+{
+    if ((reg[SIM_TA1CCTL0] & (CCIE | CCIFG)) == (CCIE | CCIFG))
+        return 13;
+    if (timer_irq(&ta[1]))
+        return 12;
+    if ((reg[SIM_TA0CCTL0] & (CCIE | CCIFG)) == (CCIE | CCIFG))
+        return 9;
+    if (timer_irq(&ta[0]))
+        return 8;
+    if (reg[SIM_IE2] & reg[SIM_IFG2] & UCA0RXIFG)
+        return 7;
+    if (reg[SIM_IE2] & reg[SIM_IFG2] & UCA0TXIFG)
+        return 6;
+    return -1;
+}
+
+static void commit(void);
+
+static void dispatch(void)
+{
+    unsigned int saved, *outer;
+    int v;
+
+    while ((sr & GIE) && (v = irq()) >= 0)
+    {
+        if (!vector[v])
+            sim_fatal("interrupt %d without an ISR", v);
+        if (v == 13)
+            reg[SIM_TA1CCTL0] &= ~CCIFG;    // single source vectors
+        else if (v == 9)
+            reg[SIM_TA0CCTL0] &= ~CCIFG;
+        isr_count[v]++;
+        saved = sr;
+        outer = exit_sr;
+        exit_sr = &saved;
+        set_sr(0);
+        cycles(ISR_ENTRY);
+        vector[v]();
+        commit();
+        cycles(ISR_EXIT);
+        exit_sr = outer;
+        set_sr(saved);
+    }
+}
+
+// Side effects of a write, applied when the firmware comes back
+static void written(int id)
+{
+    uint16_t v = reg[id];
+    int i;
+
+    switch (id)
+    {
+    case SIM_BCSCTL1:
+    case SIM_BCSCTL2:
+    case SIM_DCOCTL:
+        dco_update();
+        smclk_update();
+        break;
+    case SIM_WDTCTL:
+        if ((v & 0xFF00) != WDTPW)
+            sim_fatal("WDTCTL written without WDTPW: reset");
+        if (!(v & WDTHOLD))
+            sim_fatal("watchdog started, not modelled");
+        reg[id] = 0x6900 | (v & 0xFF);
+        break;
+    case SIM_TA0CTL:
+    case SIM_TA1CTL:
+        i = id == SIM_TA0CTL ? 0 : 1;
+        if (v & TACLR)
+        {
+            reg[ta[i].r] = 0;
+            reg[id] &= ~TACLR;
+        }
+        if (v & (ID_3))
+            sim_fatal("%s: input divider not modelled", ta[i].name);
+        ta[i].last = timer_src_n(&ta[i]);
+        break;
+    case SIM_UCA0CTL1:
+        if (v & UCSWRST)
+            spi_reset();
+        break;
+    case SIM_UCA0TXBUF:
+        spi_tx(v);
+        break;
+    case SIM_FCTL1:
+    case SIM_FCTL2:
+    case SIM_FCTL3:
+        if ((v & 0xFF00) != FWKEY)
+            sim_fatal("FCTL written without FWKEY: reset");
+        if (id == SIM_FCTL3)                // LOCKA toggles on a 1
+            v = (v & ~LOCKA) | ((pending_val ^ v) & LOCKA);
+        reg[id] = FRKEY | (v & 0xFF);
+        break;
+    }
+    pins_update();
+}
+
+static void commit(void)
+{
+    int id = pending;
+
+    if (id >= 0)
+    {
+        pending = -1;
+        if (reg[id] != pending_val || id == SIM_UCA0TXBUF)
+            written(id);
+    }
+    flash_check();
+}
+
+// Read side effects
+static void before_read(int id)
+{
+    unsigned int v, i;
+
+    switch (id)
+    {
+    case SIM_P1IN:
+        v = reg[SIM_P1DIR];
+        reg[id] = (reg[SIM_P1OUT] & v) | (~v & 0xFF);
+        break;
+    case SIM_P2IN:
+        v = reg[SIM_P2DIR];
+        reg[id] = ((reg[SIM_P2OUT] & v) | (~v & 0xFF)) & ~BIT3;
+        if (dq_level)
+            reg[id] |= BIT3;
+        break;
+    case SIM_TA0IV:
+    case SIM_TA1IV:
+        i = id == SIM_TA0IV ? 0 : 1;
+        reg[id] = timer_iv(&ta[i]);
+        break;
+    case SIM_UCA0RXBUF:
+        reg[SIM_IFG2] &= ~UCA0RXIFG;
+        reg[SIM_UCA0STAT] &= ~UCOE;
+        break;
+    case SIM_UCA0STAT:
+        if (spi.busy || spi.full)
+            reg[id] |= UCBUSY;
+        else
+            reg[id] &= ~UCBUSY;
+        break;
+    }
+}
+
+static void reg_access(int id)
+{
+    commit();
+    cycles(ACCESS_CYCLES);
+    dispatch();
+    before_read(id);
+    pending = id;
+    pending_val = reg[id];
+}
+
+volatile uint8_t *sim_reg8(int id)
+{
+    reg_access(id);
+    return (volatile uint8_t *) &reg[id];
+}
+
+volatile uint16_t *sim_reg16(int id)
+{
+    reg_access(id);
+    return &reg[id];
+}
+
+void sim_vector(unsigned int vec, void (*isr)(void))
+{
+    vector[vec & 15] = isr;
+}
+
+unsigned short __get_interrupt_state(void)
+{
+    commit();
+    cycles(1);
+    dispatch();                             // a poll loop may read only the SR
+    return sr;
+}
+
+void __set_interrupt_state(unsigned short v)
+{
+    commit();
+    cycles(1);
+    set_sr((sr & ~GIE) | (v & GIE));
+    dispatch();
+}
+
+void __disable_interrupt(void)
+{
+    commit();
+    cycles(1);
+    sr &= ~GIE;
+}
+
+void __enable_interrupt(void)
+{
+    commit();
+    cycles(1);
+    sr |= GIE;
+    dispatch();
+}
+
+void __no_operation(void)
+{
+    commit();
+    cycles(1);
+    dispatch();
+}
+
+void __delay_cycles(unsigned long n)
+{
+    commit();
+    cycles(n);
+    dispatch();
+}
+
+// Enter a low power mode: run the models from event to event until an
+// ISR clears CPUOFF in the SR it returns to
+void __bis_SR_register(unsigned short bits)
+{
+    commit();
+    set_sr(sr | bits);
+    if (!(sr & CPUOFF))
+    {
+        dispatch();
+        return;
+    }
+    if (!(sr & GIE))
+        sim_fatal("LPM with interrupts disabled, nothing wakes the CPU");
+    dispatch();
+    while (sr & CPUOFF)
+    {
+        advance_to(next_event());
+        dispatch();
+    }
+}
+
+void __bic_SR_register_on_exit(unsigned short bits)
+{
+    if (!exit_sr)
+        sim_fatal("__bic_SR_register_on_exit() outside an ISR");
+    *exit_sr &= ~bits;
+}
+
+// ##################### Main ##############################
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: sim [-s sec] [-t degC]... [-g degC/min] [-e rate]\n"
+            "           [-k sec:key[:hold]]... [-i info.bin] [-q] [-v]\n"
+            "  -s  virtual time to run, default 10 s\n"
+            "  -t  add a DS18B20 at this temperature, one at 21.5 by default\n"
+            "  -g  temperature ramp of all sensors\n"
+            "  -e  bit error rate of the sensor replies\n"
+            "  -k  press key 1..8 at sec for hold s (0.2)\n"
+            "  -i  info memory image, loaded if there and saved at the end\n"
+            "  -q  print the display at the end only\n"
+            "  -v  log bus traffic on stderr\n");
+    exit(1);
+}
+
+static int key_cmp(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+    double at, hold;
+    int c, key, sensors = 0;
+
+    while ((c = getopt(argc, argv, "s:t:g:e:k:i:qv")) != -1)
+    {
+        switch (c)
+        {
+        case 's':
+            end_ps = (uint64_t) (atof(optarg) * SIM_S);
+            break;
+        case 't':
+            ds_add(atof(optarg));
+            sensors++;
+            break;
+        case 'g':
+            ds_ramp(atof(optarg));
+            break;
+        case 'e':
+            ds_errors(atof(optarg));
+            break;
+        case 'k':
+            hold = 0.2;
+            if (sscanf(optarg, "%lf:%d:%lf", &at, &key, &hold) < 2
+                    || key < 1 || key > 8 || nkeys == 2 * MAX_KEYS)
+                usage();
+            keys[nkeys].at = (uint64_t) (at * SIM_S);
+            keys[nkeys].key = key;
+            keys[nkeys++].down = 1;
+            keys[nkeys].at = (uint64_t) ((at + hold) * SIM_S);
+            keys[nkeys].key = key;
+            keys[nkeys++].down = 0;
+            break;
+        case 'i':
+            info_file = optarg;
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        case 'v':
+            sim_verbose = 1;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+    if (!sensors)
+        ds_add(21.5);
+    qsort(keys, nkeys, sizeof keys[0], key_cmp);
+
+    // Power-up state
+    info_load();
+    reg[SIM_BCSCTL1] = 0x87;
+    reg[SIM_DCOCTL] = 0x60;
+    reg[SIM_WDTCTL] = 0x6900;
+    reg[SIM_UCA0CTL1] = UCSWRST;
+    reg[SIM_IFG2] = UCA0TXIFG;
+    reg[SIM_FCTL1] = FRKEY;
+    reg[SIM_FCTL2] = FRKEY | 0x42;
+    reg[SIM_FCTL3] = FRKEY | LOCKA | LOCK | WAIT;
+    dco_update();
+    smclk_update();
+
+    fw_main();
+    sim_fatal("fw_main() returned");
+    return 1;
+}
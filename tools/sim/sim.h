@@ -0,0 +1,37 @@
+#ifndef SIM_H_
+#define SIM_H_
+
+// Shared by the simulator core (sim.c) and its device models
+
+#include <stdint.h>
+
+#define SIM_US          1000000ULL          // ps per us, virtual time is in ps
+#define SIM_MS          (1000 * SIM_US)
+#define SIM_S           (1000 * SIM_MS)
+#define SIM_NEVER       UINT64_MAX
+
+extern uint64_t sim_ps;                     // virtual time now
+extern int sim_verbose;                     // -v: protocol log on stderr
+
+void sim_log(const char *fmt, ...);
+void sim_fatal(const char *fmt, ...);
+
+// DS18B20s on the 1-Wire bus, ds18b20_model.c
+void ds_add(double temp);
+void ds_ramp(double deg_per_min);
+void ds_errors(double rate);
+void ds_edge(int level);                    // DQ changed at sim_ps
+uint64_t ds_next(void);                     // next device event after sim_ps
+void ds_sync(void);                         // device events due at sim_ps
+int ds_pulling(void);                       // a device holds DQ low
+void ds_report(void);
+
+// TM1638 board on the SPI, tm1638_model.c
+void tm_strobe(int level);
+uint8_t tm_byte(uint8_t mosi);              // one byte clocked, returns DIO
+void tm_key(int key, int down);             // key 1..8
+int tm_changed(void);                       // display RAM written since the last call
+void tm_text(char *buf);                    // digits, then the LEDs
+void tm_report(void);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,73 @@
+// stub: the msp430sim.h hooks without the simulator, for host tools that
+// link firmware modules built with HAL_SIM but only call their pure
+// functions (crctest, numbench). Touching a register, sleeping or
+// waiting stops the program. sim_vector() is the exception: the ISRs
+// of a module register themselves at start-up.
+
+#define SIM_CORE
+#include <stdio.h>
+#include <stdlib.h>
+#include "msp430sim.h"
+
+static void unused(const char *what)
+{
+    fprintf(stderr, "%s reached, this host build has no simulator\n", what);
+    exit(2);
+}
+
+volatile uint8_t *sim_reg8(int id)
+{
+    unused("register access");
+    return 0;
+}
+
+volatile uint16_t *sim_reg16(int id)
+{
+    unused("register access");
+    return 0;
+}
+
+unsigned short __get_interrupt_state(void)
+{
+    unused("__get_interrupt_state()");
+    return 0;
+}
+
+void __set_interrupt_state(unsigned short sr)
+{
+    unused("__set_interrupt_state()");
+}
+
+void __disable_interrupt(void)
+{
+    unused("__disable_interrupt()");
+}
+
+void __enable_interrupt(void)
+{
+    unused("__enable_interrupt()");
+}
+
+void __bis_SR_register(unsigned short bits)
+{
+    unused("__bis_SR_register()");
+}
+
+void __bic_SR_register_on_exit(unsigned short bits)
+{
+    unused("__bic_SR_register_on_exit()");
+}
+
+void __delay_cycles(unsigned long cycles)
+{
+    unused("__delay_cycles()");
+}
+
+void __no_operation(void)
+{
+    unused("__no_operation()");
+}
+
+void sim_vector(unsigned int vec, void (*isr)(void))
+{
+}
@@ -0,0 +1,160 @@
+// TM1638 LED&KEY module: 8 seven segment digits, 8 LEDs, 8 keys
+//
+// Bytes count while STROBE is low, the first one is the command:
+//  0x40 | 0x04 fixed address | 0x02 read keys   data command
+//  0x80 | 0x08 on | brightness                  display control
+//  0xC0 | address                               address, data bytes follow
+// After a read keys data command the module shifts the 4 key scan bytes
+// out on DIO, pulling it low for the 0 bits; a 1 is a key down. Key n
+// (1..8) is bit 0 of scan byte n-1 for n <= 4 and bit 4 of scan byte
+// n-5 above.
+// Display RAM: digit i at 2i (bit 7 the point), LED i at 2i+1 (bit 0 red,
+// bit 1 green).
+
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+
+static uint8_t ram[16];
+static int on, bright, addr, fixed, reading, first, strobed;
+static int keys, changed;
+static unsigned int scan;                   // key scan byte next read
+static unsigned long strobes, bytes, bad;
+
+void tm_strobe(int level)
+{
+    strobed = !level;
+    if (strobed)
+    {
+        first = 1;
+        strobes++;
+    }
+}
+
+static void command(uint8_t b)
+{
+    switch (b & 0xC0)
+    {
+    case 0x40:
+        fixed = (b & 0x04) != 0;
+        reading = (b & 0x02) != 0;
+        scan = 0;
+        sim_log("tm1638: data command 0x%02X", b);
+        break;
+    case 0x80:
+        on = (b & 0x08) != 0;
+        bright = b & 0x07;
+        changed = 1;
+        sim_log("tm1638: display %s, brightness %d", on ? "on" : "off", bright);
+        break;
+    case 0xC0:
+        addr = b & 0x0F;
+        break;
+    default:
+        bad++;
+        sim_log("tm1638: unknown command 0x%02X", b);
+    }
+}
+
+uint8_t tm_byte(uint8_t mosi)
+{
+    uint8_t out = 0xFF;
+
+    if (!strobed)
+        return 0xFF;
+    bytes++;
+    if (first)
+    {
+        first = 0;
+        command(mosi);
+        return 0xFF;
+    }
+    if (reading)
+    {
+        if (scan < 4)
+        {
+            out = 0;
+            if (keys & (1 << scan))
+                out |= 0x01;
+            if (keys & (0x10 << scan))
+                out |= 0x10;
+            scan++;
+        }
+        return out;
+    }
+    if (ram[addr] != mosi)
+        changed = 1;
+    ram[addr] = mosi;
+    if (!fixed)
+        addr = (addr + 1) & 0x0F;
+    return 0xFF;
+}
+
+void tm_key(int key, int down)
+{
+    if (down)
+        keys |= 1 << (key - 1);
+    else
+        keys &= ~(1 << (key - 1));
+}
+
+int tm_changed(void)
+{
+    int c = changed;
+
+    changed = 0;
+    return c;
+}
+
+static char segments(uint8_t seg)
+{
+    static const struct
+    {
+        uint8_t seg;
+        char c;
+    } font[] = {
+        { 0x3F, '0' }, { 0x06, '1' }, { 0x5B, '2' }, { 0x4F, '3' },
+        { 0x66, '4' }, { 0x6D, '5' }, { 0x7D, '6' }, { 0x07, '7' },
+        { 0x27, '7' }, { 0x7F, '8' }, { 0x6F, '9' }, { 0x77, 'A' },
+        { 0x7C, 'b' }, { 0x39, 'C' }, { 0x5E, 'd' }, { 0x79, 'E' },
+        { 0x71, 'F' }, { 0x50, 'r' }, { 0x5C, 'o' }, { 0x40, '-' },
+        { 0x38, 'L' }, { 0x76, 'H' }, { 0x3E, 'U' }, { 0x63, '*' },
+        { 0x73, 'P' }, { 0x54, 'n' }, { 0x74, 'h' }, { 0x08, '_' },
+        { 0x04, 'i' }, { 0x58, 'c' }, { 0x1C, 'u' }, { 0x6E, 'y' },
+        { 0x3D, 'G' }, { 0x5F, 'a' }, { 0x2A, 'v' }, { 0x00, ' ' }
+    };
+    unsigned int i;
+
+    for (i = 0; i < sizeof font / sizeof font[0]; i++)
+        if (font[i].seg == seg)
+            return font[i].c;
+    return '?';
+}
+
+// "[1. 0 0.0 1.0 5] LEDs --------", blank when the display is off
+void tm_text(char *buf)
+{
+    int i;
+
+    *buf++ = '[';
+    for (i = 0; i < 8; i++)
+    {
+        *buf++ = on ? segments(ram[2 * i] & 0x7F) : ' ';
+        if (on && (ram[2 * i] & 0x80))
+            *buf++ = '.';
+    }
+    strcpy(buf, "] LEDs ");
+    buf += strlen(buf);
+    for (i = 0; i < 8; i++)
+    {
+        uint8_t led = on ? ram[2 * i + 1] & 3 : 0;
+        *buf++ = led == 3 ? 'Y' : led == 2 ? 'G' : led == 1 ? 'R' : '-';
+    }
+    *buf = 0;
+}
+
+void tm_report(void)
+{
+    printf("tm1638: %lu strobes, %lu bytes, %lu unknown commands, brightness %d\n",
+            strobes, bytes, bad, bright);
+}
@@ -0,0 +1,317 @@
+// tracedump - host side decoder for the firmware trace ring (trace.h)
+//
+// Build:  cc -O2 -o tracedump tracedump.c -lm
+// Usage:  tracedump [-f hz] [-n src=name]... dump
+//
+// dump is a memory save of trace_ring from the debugger, raw binary or
+// TI data format (the "1651 ..." text files). The ring is found by its
+// magic word, so a save of the whole RAM works as well. For every
+// source it prints, in microseconds:
+//  duration - ENTER to EXIT, interrupts nested in a task included
+//  period   - ENTER to ENTER, with the jitter around the mean
+//  latency  - DUE to ENTER, for sources that record when they were due
+// and a log2 histogram of each. Each record carries the 16-bit clock and
+// the firmware's count of its wraps (mod 512), so intervals up to 2^25
+// ticks are exact: 16s at 2MHz, 2s at 16MHz, 17min on ACLK. Longer ones
+// alias. Latency stays within one wrap, the due time is a compare value
+// that can be from the wrap before the record. Pairs across a HOLD or
+// MARK are skipped, the firmware's timestamps restart there.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TRACE_MAGIC     0x7ACF
+#define EV_ENTER        0x00
+#define EV_EXIT         0x01
+#define EV_DUE          0x02
+#define EV_MARK         0x03
+#define EV_HOLD         0x04
+
+// Event word: kind 15..13, wraps 12..4, source 3..0
+#define EV_KIND(w)      ((w) >> 13)
+#define EV_WRAPS(w)     (((w) >> 4) & 0x1FF)
+#define EV_SOURCE(w)    ((w) & 0x0F)
+#define TIME_MASK       0x1FFFFFFUL     // 25 bits: wraps and clock
+
+#define MAX_WORDS       65536
+#define SOURCES         16
+#define BUCKETS         26
+
+typedef struct
+{
+    unsigned long n;
+    unsigned long min, max;
+    double sum, sumsq;
+    unsigned long hist[BUCKETS];
+} stat_t;
+
+typedef struct
+{
+    const char *name;
+    int open, period_ok;        // ENTER seen with no EXIT yet / last ENTER usable
+    unsigned long enter, last_enter, due;
+    int has_due;
+    stat_t duration, period, latency, jitter;
+} source_t;
+
+static unsigned int words[MAX_WORDS];
+static unsigned int nwords;
+static source_t src[SOURCES];
+static double tick_us;
+
+// ##### Input #####
+
+static int load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    char line[256];
+    int c0, c1;
+
+    if (!f)
+        return -1;
+    if (fgets(line, sizeof line, f) && strncmp(line, "1651", 4) == 0)
+    { // TI data format: header line, then one hex word per line
+        unsigned int w;
+
+        while (nwords < MAX_WORDS && fscanf(f, " 0x%x", &w) == 1)
+            words[nwords++] = w & 0xFFFF;
+    }
+    else
+    { // Raw little endian memory
+        rewind(f);
+        while (nwords < MAX_WORDS && (c0 = getc(f)) != EOF
+                && (c1 = getc(f)) != EOF)
+            words[nwords++] = c0 | (c1 << 8);
+    }
+    fclose(f);
+    return 0;
+}
+
+// ##### Statistics #####
+
+static unsigned int bucket(unsigned long v)
+{
+    unsigned int b = 0;
+
+    while (v > 1 && b < BUCKETS - 1)
+    {
+        v >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void add(stat_t *s, unsigned long v)
+{
+    if (s->n == 0 || v < s->min)
+        s->min = v;
+    if (s->n == 0 || v > s->max)
+        s->max = v;
+    s->n++;
+    s->sum += v;
+    s->sumsq += (double) v * v;
+    s->hist[bucket(v)]++;
+}
+
+static void print(const char *what, const stat_t *s)
+{
+    unsigned int b;
+    unsigned long peak = 0;
+    double mean, sd;
+
+    if (s->n == 0)
+        return;
+    mean = s->sum / s->n;
+    sd = sqrt(s->sumsq / s->n - mean * mean > 0 ? s->sumsq / s->n - mean * mean : 0);
+    printf("  %-9s n %-6lu min %9.1f  avg %9.1f  max %9.1f  sd %8.1f us\n",
+            what, s->n, s->min * tick_us, mean * tick_us, s->max * tick_us,
+            sd * tick_us);
+    for (b = 0; b < BUCKETS; b++)
+        if (s->hist[b] > peak)
+            peak = s->hist[b];
+    for (b = 0; b < BUCKETS; b++)
+    {
+        unsigned int bar;
+
+        if (!s->hist[b])
+            continue;
+        bar = (unsigned int) ((s->hist[b] * 40 + peak - 1) / peak);
+        printf("    < %9.1f us %6lu ", (2UL << b) * tick_us, s->hist[b]);
+        while (bar--)
+            putchar('#');
+        putchar('\n');
+    }
+}
+
+// ##### Decoder #####
+
+static void void_all(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < SOURCES; i++)
+    {
+        src[i].open = 0;
+        src[i].period_ok = 0;
+        src[i].has_due = 0;
+    }
+}
+
+// One pass over the records oldest first. Pass 0 collects everything,
+// pass 1 the deviation of each period from the mean of pass 0.
+static void decode(const unsigned int *rec, unsigned int len,
+        unsigned int head, int pass)
+{
+    unsigned int i, hold = 0;
+
+    void_all();
+    for (i = 0; i < len; i++)
+    {
+        const unsigned int *r = &rec[2 * ((head + i) % len)];
+        unsigned int kind = EV_KIND(r[0]), id = EV_SOURCE(r[0]);
+        unsigned long t = ((unsigned long) EV_WRAPS(r[0]) << 16) | r[1];
+        source_t *s = &src[id];
+
+        if (kind == EV_HOLD)
+        {
+            hold = 1;
+            void_all();
+            continue;
+        }
+        if (kind == EV_MARK)
+        {
+            hold = 0;
+            void_all();
+            continue;
+        }
+        if (hold || id == 0)    // id 0: never written
+            continue;
+        switch (kind)
+        {
+        case EV_ENTER:
+            if (s->period_ok)
+            {
+                unsigned long p = (t - s->last_enter) & TIME_MASK;
+
+                if (pass == 0)
+                {
+                    add(&s->period, p);
+                }
+                else
+                {
+                    double dev = p - s->period.sum / s->period.n;
+
+                    add(&s->jitter, (unsigned long) (dev < 0 ? -dev : dev));
+                }
+            }
+            s->last_enter = t;
+            s->period_ok = 1;
+            s->enter = t;
+            s->open = 1;
+            s->has_due = 0;
+            break;
+        case EV_DUE:
+            s->due = t;
+            s->has_due = 1;
+            break;
+        case EV_EXIT:
+            if (s->open && pass == 0)
+            {
+                add(&s->duration, (t - s->enter) & TIME_MASK);
+                if (s->has_due)
+                    add(&s->latency, (s->enter - s->due) & 0xFFFF);
+            }
+            s->open = 0;
+            break;
+        }
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: tracedump [-f hz] [-n src=name]... dump\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = 0;
+    unsigned long freq = 0;
+    unsigned int i, len, head;
+    int a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "-f") == 0 && a + 1 < argc)
+        {
+            freq = strtoul(argv[++a], 0, 0);
+        }
+        else if (strcmp(argv[a], "-n") == 0 && a + 1 < argc)
+        {
+            char *eq;
+            unsigned long id = strtoul(argv[++a], &eq, 0);
+
+            if (*eq != '=' || id >= SOURCES)
+                usage();
+            src[id].name = eq + 1;
+        }
+        else if (argv[a][0] != '-' && !path)
+        {
+            path = argv[a];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (!path)
+        usage();
+    if (load(path))
+    {
+        perror(path);
+        return 1;
+    }
+
+    // magic, len, head, freq low, freq high, then len records of ev, t
+    for (i = 0; i + 5 <= nwords; i++)
+    {
+        len = words[i + 1];
+        if (words[i] == TRACE_MAGIC && len && !(len & (len - 1))
+                && words[i + 2] < len && i + 5 + 2 * len <= nwords)
+            break;
+    }
+    if (i + 5 > nwords)
+    {
+        fprintf(stderr, "%s: no trace ring found\n", path);
+        return 1;
+    }
+    head = words[i + 2];
+    if (!freq)
+        freq = words[i + 3] | ((unsigned long) words[i + 4] << 16);
+    if (!freq)
+        usage();
+    tick_us = 1e6 / freq;
+    printf("%u records, clock %lu Hz (%.2f us)\n", len, freq, tick_us);
+
+    decode(&words[i + 5], len, head, 0);
+    decode(&words[i + 5], len, head, 1);
+
+    for (a = 1; a < SOURCES; a++)
+    {
+        source_t *s = &src[a];
+
+        if (!s->duration.n && !s->period.n)
+            continue;
+        if (s->name)
+            printf("source %d %s\n", a, s->name);
+        else
+            printf("source %d\n", a);
+        print("duration", &s->duration);
+        print("period", &s->period);
+        print("jitter", &s->jitter);
+        print("latency", &s->latency);
+    }
+    return 0;
+}